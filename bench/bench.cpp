@@ -0,0 +1,300 @@
+// bench.cpp — microbenchmarks for the hot-path primitives; results as JSON
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#include "core.hpp"
+#include "metrics.hpp"
+#include "render.hpp"
+#include "screen.hpp"
+#include "term.hpp"
+
+#ifndef PIPES_VERSION
+  #define PIPES_VERSION "dev"
+#endif
+
+using namespace std;
+using clk = chrono::steady_clock;
+
+static double g_min_ms = 200.0;
+static string g_filter;
+static volatile uint64_t g_sink;
+static vector<string> g_results;
+
+// Allocation counter for --check-alloc. Replacing the global operator new covers
+// every std container in the binary, on any thread; the cost is one increment per allocation.
+static atomic<long long> g_allocs{0};
+void* operator new(size_t n){
+  g_allocs.fetch_add(1, memory_order_relaxed);
+  if (void* p=malloc(n ? n : 1)) return p;
+  throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static bool wanted(const char* name){ return g_filter.empty() || strstr(name, g_filter.c_str()); }
+
+// Run body(n) with growing n until it takes at least g_min_ms; returns ns per op.
+template<class F> static double measure(F&& body, long long& ops){
+  long long n=64;
+  while (true){
+    const auto t0=clk::now();
+    body(n);
+    const double ms=chrono::duration<double,milli>(clk::now()-t0).count();
+    if (ms>=g_min_ms || n>=(1LL<<40)){ ops=n; return ms*1e6/(double)n; }
+    n = ms<1.0 ? n*16 : (long long)((double)n*g_min_ms*1.2/ms)+1;
+  }
+}
+
+// One JSON record; a short human-readable line goes to stderr.
+static void report(const string& name, const string& label, const string& extra, double ns, long long ops){
+  char line[512];
+  snprintf(line, sizeof line, "    {\"name\": \"%s\"%s, \"ns_per_op\": %.3f, \"ops\": %lld}",
+           name.c_str(), extra.c_str(), ns, ops);
+  g_results.push_back(line);
+  fprintf(stderr, "%-14s %-22s %14.3f ns/op\n", name.c_str(), label.c_str(), ns);
+}
+
+static void setup(int W, int H, int pipes){
+  srand(1);
+  cfg = Config{}; cfg.p=pipes; cfg.limit=0; cfg.seed=1; drawn=0;
+  activeTypes={0}; palette={1,2,3,4,5,6,7,0};
+  term.W=W; term.H=H; term.out.sink=SINK_NULL;
+  term.cx=term.cy=term.sfg=term.sbold=-1;
+  pending.reset(); pending.W=W; pending.H=H;
+  screen.resize(0,0);
+}
+
+static void bench_primitives(){
+  setup(80,24,1);
+  long long ops;
+  if (wanted("idx_from")){
+    double ns=measure([](long long n){
+      uint64_t acc=0;
+      for (long long i=0;i<n;i++) acc+=idx_from((Direction)(i&3), (Direction)((i>>2)&3));
+      g_sink=acc;
+    }, ops);
+    report("idx_from", "", "", ns, ops);
+  }
+  if (wanted("would_exit")){
+    double ns=measure([](long long n){
+      uint64_t acc=0; State s;
+      for (long long i=0;i<n;i++){ s.x=(int)(i%81)-1; s.y=(int)(i%25)-1; acc+=would_exit(s,(Direction)(i&3)); }
+      g_sink=acc;
+    }, ops);
+    report("would_exit", "", "", ns, ops);
+  }
+  if (wanted("glyph_lookup")){
+    double ns=measure([](long long n){
+      uint64_t acc=0;
+      for (long long i=0;i<n;i++) acc+=glyph_of(glyph_id((int)(i%10), 1+(int)((i/10)&15))).n;
+      g_sink=acc;
+    }, ops);
+    report("glyph_lookup", "", "", ns, ops);
+  }
+  // SGR encoding replaced ansi_color(); every op is a color transition.
+  if (wanted("sgr_encode")){
+    double ns=measure([](long long n){
+      for (long long i=0;i<n;i++){
+        term.sgr(fg_code((int)(i&7)), (i>>3)&1);
+        if (term.out.len>4096) term.out.len=0;
+      }
+      term.out.len=0;
+    }, ops);
+    report("sgr_encode", "", "", ns, ops);
+  }
+  if (wanted("cursor_plan")){
+    vector<int> pts(2048);
+    for (size_t i=0;i<pts.size();i++) pts[i]=rand()%(200*60);
+    double ns=measure([&](long long n){
+      char buf[64]; uint64_t acc=0;
+      for (long long i=0;i<n;i++){
+        const int a=pts[(size_t)i&2047], b=pts[(size_t)(i+1)&2047];
+        term.cx=a%200; term.cy=a/200;
+        acc+=(uint64_t)term.plan(b%200, b/200, buf);
+      }
+      g_sink=acc;
+    }, ops);
+    report("cursor_plan", "", "", ns, ops);
+  }
+}
+
+static void bench_frames(){
+  static const int sizes[][2] = { {80,24}, {200,60}, {400,120} };
+  static const int counts[] = { 1, 8, 100, 10000 };
+  for (auto& sz: sizes) for (int p: counts){
+    char extra[96], label[48];
+    snprintf(extra, sizeof extra, ", \"size\": \"%dx%d\", \"pipes\": %d", sz[0], sz[1], p);
+    snprintf(label, sizeof label, "%dx%d p=%d", sz[0], sz[1], p);
+    long long ops;
+    // Whole step_all frames, settle and occupancy tracking included, per pipe step:
+    // step_scalar forces the per-pipe path, step_batch runs the SoA kernel 8 pipes at a time.
+    for (int simd=0; simd<2; simd++){
+      const char* name = simd ? "step_batch" : "step_scalar";
+      if (!wanted(name)) continue;
+      setup(sz[0], sz[1], p);
+      cfg.simd = simd!=0;
+      Pipes S=spawn_pipes();
+      long long last_reset=0;
+      // One op is one pipe step; steps run as whole frames.
+      double ns=measure([&](long long n){
+        for (long long i=0;i<n;i+=p){ step_all(S, last_reset); pending.reset(); }
+      }, ops);
+      report(name, label, extra, ns, ops);
+    }
+    if (wanted("frame_encode")){
+      setup(sz[0], sz[1], p);
+      Pipes S=spawn_pipes();
+      long long last_reset=0;
+      double encNs=0; long long frames=0;
+      const long long b0=term.out.bytes;
+      measure([&](long long n){
+        for (long long i=0;i<n;i++){
+          step_all(S, last_reset);
+          const auto t0=clk::now();
+          apply_frame(pending); pending.reset();
+          screen.flush(); term.out.commit();
+          encNs+=chrono::duration<double,nano>(clk::now()-t0).count();
+          ++frames;
+        }
+      }, ops);
+      char more[160];
+      snprintf(more, sizeof more, "%s, \"bytes_per_frame\": %.1f", extra,
+               (double)(term.out.bytes-b0)/(double)frames);
+      report("frame_encode", label, more, encNs/(double)frames, frames);
+    }
+  }
+}
+
+// Thread scaling for big pipe sets: same frames, 1..N simulation workers, with no
+// draw limit and with the default erase limit (the trail upkeep runs in the workers too).
+static void bench_threads(){
+  if (!wanted("step_threads")) return;
+  const int p=100000, hw=max(1, (int)thread::hardware_concurrency());
+  for (long long limit: {0LL, Config{}.limit})
+    for (int t=1; ; t=min(t*2, hw)){
+      char extra[128], label[48];
+      snprintf(extra, sizeof extra, ", \"size\": \"400x120\", \"pipes\": %d, \"limit\": %lld, \"threads\": %d", p, limit, t);
+      snprintf(label, sizeof label, "400x120 p=%d r=%lld t=%d", p, limit, t);
+      setup(400, 120, p);
+      cfg.threads=t; cfg.limit=limit;
+      Pipes S=spawn_pipes();
+      long long last_reset=0, ops;
+      double ns=measure([&](long long n){
+        for (long long i=0;i<n;i+=p){ step_all(S, last_reset); pending.reset(); }
+      }, ops);
+      report("step_threads", label, extra, ns, ops);
+      if (t==hw) break;
+    }
+}
+
+// Steady state must not allocate: run sim ticks on this thread into the frame ring and
+// the real render thread (Renderer::run, with metrics and the stats overlay) behind it,
+// through a warm-up, then count heap allocations over the frames that follow. Output
+// takes the async terminal path into a pipe that a reader thread empties.
+static int check_alloc(){
+  struct Case { const char* name; int W, H, p, limit, threads; LimitMode mode; bool noColor, keepOnEdge, stats; };
+  static const Case cases[] = {
+    { "80x24 p=8 stats",       80,  24,     8,      0, 1, LIMIT_ERASE, false, true,  true  },
+    { "200x60 p=100 erase",   200,  60,   100,   5000, 1, LIMIT_ERASE, false, false, false },
+    { "200x60 p=100 clear",   200,  60,   100,   5000, 1, LIMIT_CLEAR, false, false, true  },
+    { "200x60 p=100 mono",    200,  60,   100,      0, 1, LIMIT_ERASE, true,  true,  false },
+    { "400x120 p=10000 t=2",  400, 120, 10000, 200000, 2, LIMIT_ERASE, false, false, true  },
+  };
+  const int warm=300, frames=1000, rollEvery=50;
+#ifndef _WIN32
+  int fds[2];
+  if (pipe(fds)!=0){ perror("pipe"); return 1; }
+  #ifdef F_SETPIPE_SZ
+  fcntl(fds[1], F_SETPIPE_SZ, 1<<20);
+  #endif
+  fflush(stdout);
+  const int saved=dup(STDOUT_FILENO);
+  dup2(fds[1], STDOUT_FILENO); close(fds[1]);
+  thread reader([rfd=fds[0]]{ static char b[1<<16]; while (read(rfd, b, sizeof b)>0) {} });
+#endif
+  int failed=0;
+  for (const Case& c: cases){
+    setup(c.W, c.H, c.p);
+    cfg.limit=c.limit; cfg.limitMode=c.mode; cfg.threads=c.threads; cfg.noColor=c.noColor; cfg.keepOnEdge=c.keepOnEdge;
+#ifndef _WIN32
+    term.out.sink=SINK_TTY;
+    term.out.setAsync(true);
+#endif
+    Pipes S=spawn_pipes();
+    Metrics metrics;
+#ifndef _WIN32
+    metrics.open("/dev/null");
+#endif
+    Renderer renderer;
+    renderer.metrics=&metrics;
+    renderer.showStats.store(c.stats);
+    renderer.open();
+    atomic<bool> stop{false};
+    thread render([&]{ renderer.run(stop); });
+    long long last_reset=0, before=0;
+    for (int f=0; f<warm+frames; f++){
+      if (f==warm) before=g_allocs.load();
+      const auto t0=clk::now();
+      step_all(S, last_reset);
+      metrics.tick((uint64_t)chrono::nanoseconds(clk::now()-t0).count());
+      // One frame per delta: wait for the renderer to take it.
+      while (!ring.push(pending)) this_thread::yield();
+      renderer.wake();
+      while (ring.front()) this_thread::yield();
+      if (f%rollEvery==rollEvery-1){ metrics.roll(0.1, 60, S.size(), RunCounters{f, f/7}); renderer.wake(); }
+    }
+    const long long n=g_allocs.load()-before;
+    stop.store(true);
+    renderer.wake();
+    render.join();
+    term.out.setAsync(false);
+    fprintf(stderr, "check_alloc    %-22s %6lld allocations in %d frames\n", c.name, n, frames);
+    if (n) ++failed;
+  }
+#ifndef _WIN32
+  dup2(saved, STDOUT_FILENO); close(saved);
+  reader.join(); close(fds[0]);
+#endif
+  return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv){
+  const char* outPath=nullptr;
+  for (int i=1;i<argc;i++){
+    string a=argv[i];
+    if (a=="--min-ms" && i+1<argc) g_min_ms=atof(argv[++i]);
+    else if (a=="--filter" && i+1<argc) g_filter=argv[++i];
+    else if (a=="--out" && i+1<argc) outPath=argv[++i];
+    else if (a=="--check-alloc"){ init_types(); return check_alloc(); }
+    else if (a=="-h" || a=="--help"){
+      printf("Usage: %s [--min-ms MS] [--filter NAME] [--out FILE.json] | --check-alloc\n", argv[0]); return 0;
+    }
+    else { fprintf(stderr, "Unknown option: %s\n", a.c_str()); return 1; }
+  }
+  init_types();
+  bench_primitives();
+  bench_frames();
+  bench_threads();
+
+  FILE* f = outPath ? fopen(outPath, "w") : stdout;
+  if (!f){ fprintf(stderr, "Error: cannot open %s\n", outPath); return 1; }
+  fprintf(f, "{\n  \"version\": \"%s\",\n  \"min_ms\": %.1f,\n  \"results\": [\n", PIPES_VERSION, g_min_ms);
+  for (size_t i=0;i<g_results.size();i++) fprintf(f, "%s%s\n", g_results[i].c_str(), i+1<g_results.size()? ",":"");
+  fprintf(f, "  ]\n}\n");
+  if (outPath) fclose(f);
+  return 0;
+}
@@ -0,0 +1,521 @@
+// core.cpp — pipe simulation
+
+#include "core.hpp"
+#include "screen.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+using namespace std;
+
+Config cfg;
+vector<int> activeTypes;
+vector<int> palette;
+long long drawn=0;
+Occupancy occupancy;
+
+constexpr PipeType BUILTIN_TYPES[10] = {
+  pipe_type({ "┃","┏"," ","┓","┛","━","┓"," "," ","┗","┃","┛","┗"," ","┏","━" }),
+  pipe_type({ "│","╭"," ","╮","╯","─","╮"," "," ","╰","│","╯","╰"," ","╭","─" }),
+  pipe_type({ "│","┌"," ","┐","┘","─","┐"," "," ","└","│","┘","└"," ","┌","─" }),
+  pipe_type({ "║","╔"," ","╗","╝","═","╗"," "," ","╚","║","╝","╚"," ","╔","═" }),
+  pipe_type({ "|","+"," ","+","+","-","+"," "," ","+","|","+","+"," ","+","-" }),
+  pipe_type({ "|","/"," ","\\","\\","-","\\"," "," ","\\","|","\\","/"," ","/","-" }),
+  pipe_type({ ".","."," ",".",".",".","."," "," ",".",".",".","."," ",".","." }),
+  pipe_type({ ".","o"," ","o","o",".","o"," "," ","o",".","o","o"," ","o","." }),
+  pipe_type({ "|","-"," ","|","\\","-","\\"," "," ","\\","|","/","/"," ","-","-" }),
+  pipe_type({ "╿","┎"," ","┒","┛","╾","┒"," "," ","┖","╿","┛","┖"," ","┎","╾" }),
+};
+PipeType T[TYPE_SLOTS];
+
+void init_types(){
+  copy(begin(BUILTIN_TYPES), end(BUILTIN_TYPES), T);
+  // ' '..'~' in order; the one slot past '~' stays blank.
+  for (int k=0; k<(TYPE_SLOTS-TEXT_TYPE)*16; k++)
+    T[TEXT_TYPE + k/16].g[k%16] = Glyph{{(char)(k<95 ? ' '+k : ' ')}, 1};
+}
+
+static inline bool occupied(const State& s, Direction d){
+  int nx=s.x, ny=s.y;
+  if (d==UP) --ny; else if (d==DOWN) ++ny; else if (d==LEFT) --nx; else ++nx;
+  return occupancy.test(nx, ny);
+}
+
+// Step kernels are specialized on the boolean config axes, folded into a kernel index.
+constexpr unsigned K_KEEP=1, K_AVOID=2, K_COLOR=4, K_VIVID=8, K_BOLD=16, K_COUNT=32;
+
+static unsigned kernel_key(){
+  const bool color=!cfg.noColor;
+  return (cfg.keepOnEdge? K_KEEP: 0u) | (cfg.avoid? K_AVOID: 0u) | (color? K_COLOR: 0u)
+       | (color && cfg.vivid? K_VIVID: 0u) | (color && !cfg.noBold? K_BOLD: 0u);
+}
+
+template <unsigned K> static int advance_k(State& s){
+  // One draw per step: the straight roll, plus bit 0 (turn side) and bit 1 (edge side).
+  uint32_t r;
+  s.out = s.in;
+  if (s.rng.below(20, r) >= (uint32_t)cfg.straight) s.out = ((r & 1)? turn_left(s.in): turn_right(s.in));
+  if (would_exit(s, s.out)){
+    if (!(K & K_KEEP)){
+      s.colorIndex = palette[s.rng.below((uint32_t)palette.size())];
+      s.typeIndex  = (int)s.rng.below((uint32_t)activeTypes.size());
+    }
+    Direction L=turn_left(s.in), R=turn_right(s.in);
+    bool okL=!would_exit(s,L), okR=!would_exit(s,R);
+    if (okL && okR) s.out = ((r & 2)? L:R);
+    else if (okL)   s.out = L;
+    else if (okR)   s.out = R;
+    else            s.out = s.in;
+  }
+  // Steer into a free cell when the pick is drawn over and another way is not. The map
+  // only changes between frames, so every pipe sees the same start-of-frame state.
+  if ((K & K_AVOID) && occupied(s, s.out)){
+    const Direction L=turn_left(s.in), R=turn_right(s.in);
+    const Direction alt[2] = { s.out==s.in ? ((r & 1)? L: R) : s.in,
+                               s.out==L ? R : s.out==R ? L : ((r & 1)? R: L) };
+    for (Direction d: alt) if (!would_exit(s, d) && !occupied(s, d)){ s.out=d; break; }
+  }
+  int idx = idx_from(s.in, s.out);
+  s.in = s.out;
+  if (s.in==UP) --s.y; else if (s.in==DOWN) ++s.y; else if (s.in==LEFT) --s.x; else ++s.x;
+  return idx;
+}
+
+// The cell for a step: fg_code() and the bold rule with the color axes fixed.
+template <unsigned K> static inline Cell make_cell_k(int type, int color, int idx){
+  Cell c; c.glyph=glyph_id(activeTypes[type], idx);
+  c.color = (K & K_COLOR) ? (uint8_t)(((K & K_VIVID)? 90: 30) + (color & 7)) : 39;
+  c.attr  = (K & K_BOLD) ? A_BOLD : 0;
+  return c;
+}
+
+#if defined(__GNUC__)
+// Batch kernel on GCC/Clang vector extensions: one source, compiled for the
+// baseline ISA and (on x86-64) for AVX2, picked once at startup.
+typedef uint32_t u32x8 __attribute__((vector_size(32)));
+typedef int32_t  i32x8 __attribute__((vector_size(32)));
+#define LD(V,p)  ({ V v_; memcpy(&v_, (p), sizeof v_); v_; })
+#define ST(p,v)  do { auto v_=(v); memcpy((p), &v_, sizeof v_); } while (0)
+#define SEL(m,a,b) (((a)&(m)) | ((b)&~(m)))
+#define ROTL(v,k)  (((v)<<(k)) | ((v)>>(32-(k))))
+#define DX(d)    ((i32x8)((d)==3) - (i32x8)((d)==1))
+#define DY(d)    ((i32x8)((d)==0) - (i32x8)((d)==2))
+#define EXITS(d) ({ const i32x8 nx_=x+DX(d), ny_=y+DY(d); \
+                    (i32x8)((nx_<0) | (nx_>=W) | (ny_<0) | (ny_>=H)); })
+
+// Same decisions as advance_k() for pipes [i,i+8). Returns false, leaving them
+// untouched, when a lane needs the scalar path: a Lemire rejection on the
+// straight roll, or an edge hit that re-rolls color/type.
+template <bool Keep> __attribute__((always_inline)) static inline bool
+step8_body(Pipes& P, size_t i, int32_t* px, int32_t* py, int32_t* idx, int W, int H, uint32_t straight){
+  u32x8 s0=LD(u32x8,&P.s0[i]), s1=LD(u32x8,&P.s1[i]), s2=LD(u32x8,&P.s2[i]), s3=LD(u32x8,&P.s3[i]);
+  const u32x8 r=ROTL(s1*5u, 7)*9u, t=s1<<9;
+  s2^=s0; s3^=s1; s1^=s2; s0^=s3; s2^=t; s3=ROTL(s3, 11);
+  // Lemire on n=20 in 32-bit lanes: hi=(r*20)>>32 via 16-bit halves, lo=r*20 mod 2^32.
+  const u32x8 lo=r*20u, hi=((r>>16)*20u + (((r&0xFFFFu)*20u)>>16)) >> 16;
+  const i32x8 reject=(i32x8)(lo < 16u);          // (2^32-20) % 20 == 16
+  for (int k=0;k<8;k++) if (reject[k]) return false;
+
+  const i32x8 x=LD(i32x8,&P.x[i]), y=LD(i32x8,&P.y[i]), in=LD(i32x8,&P.in[i]);
+  const i32x8 L=(in+3)&3, R=(in+1)&3;
+  const i32x8 bit0=(i32x8)((r&1u)!=0u), bit1=(i32x8)((r&2u)!=0u);
+  i32x8 out=SEL((i32x8)(hi>=straight), SEL(bit0,L,R), in);
+  const i32x8 ex=EXITS(out);
+  if (!Keep) for (int k=0;k<8;k++) if (ex[k]) return false;
+  const i32x8 okL=~EXITS(L), okR=~EXITS(R);
+  const i32x8 edge=SEL(okL&okR, SEL(bit1,L,R), SEL(okL, L, SEL(okR, R, in)));
+  out=SEL(ex, edge, out);
+
+  ST(px, x); ST(py, y);
+  ST(idx, in*4 + out + 1);                     // idx_from() for every reachable (in,out)
+  ST(&P.x[i], x+DX(out)); ST(&P.y[i], y+DY(out));
+  ST(&P.in[i], out); ST(&P.out[i], out);
+  ST(&P.s0[i], s0); ST(&P.s1[i], s1); ST(&P.s2[i], s2); ST(&P.s3[i], s3);
+  return true;
+}
+#undef EXITS
+#undef DY
+#undef DX
+#undef ROTL
+#undef SEL
+#undef ST
+#undef LD
+
+typedef bool (*Step8)(Pipes&, size_t, int32_t*, int32_t*, int32_t*, int, int, uint32_t);
+template <bool Keep>
+static bool step8_base(Pipes& P, size_t i, int32_t* px, int32_t* py, int32_t* idx, int W, int H, uint32_t st){
+  return step8_body<Keep>(P, i, px, py, idx, W, H, st);
+}
+#if defined(__x86_64__)
+template <bool Keep> __attribute__((target("avx2")))
+static bool step8_avx2(Pipes& P, size_t i, int32_t* px, int32_t* py, int32_t* idx, int W, int H, uint32_t st){
+  return step8_body<Keep>(P, i, px, py, idx, W, H, st);
+}
+#endif
+template <bool Keep> static Step8 pick_step8(){
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return step8_avx2<Keep>;
+#endif
+  return step8_base<Keep>;
+}
+#else
+typedef bool (*Step8)(Pipes&, size_t, int32_t*, int32_t*, int32_t*, int, int, uint32_t);
+template <bool Keep> static Step8 pick_step8(){ return nullptr; }
+#endif
+static const Step8 step8_for[2] = { pick_step8<false>(), pick_step8<true>() };
+
+// Step pipes [b,e) and append their puts, in pipe order, to out. Reads only the
+// shared config, so disjoint ranges can run on different threads.
+template <unsigned K> static void step_range_k(Pipes& P, size_t b, size_t e, vector<Put>& out){
+  auto scalar=[&](size_t j){
+    State s=P.get(j);
+    const int x=s.x, y=s.y;
+    const int idx=advance_k<K>(s);
+    P.set(j, s);
+    out.push_back(Put{(uint16_t)x,(uint16_t)y,make_cell_k<K>(s.typeIndex, s.colorIndex, idx)});
+  };
+  size_t i=b;
+  const Step8 step8=step8_for[(K & K_KEEP)? 1: 0];
+  if (!(K & K_AVOID) && step8 && cfg.simd){
+    int32_t px[8], py[8], idx[8];
+    const uint32_t straight=(uint32_t)cfg.straight;
+    for (; i+8<=e; i+=8){
+      if (step8(P, i, px, py, idx, term.W, term.H, straight))
+        for (size_t k=0;k<8;k++)
+          out.push_back(Put{(uint16_t)px[k],(uint16_t)py[k],make_cell_k<K>(P.type[i+k], P.color[i+k], idx[k])});
+      else
+        for (size_t k=0;k<8;k++) scalar(i+k);
+    }
+  }
+  for (; i<e; i++) scalar(i);
+}
+
+// One stepper per kernel index.
+typedef void (*StepRange)(Pipes&, size_t, size_t, vector<Put>&);
+template <size_t... K> static constexpr array<StepRange, sizeof...(K)> kernel_table(index_sequence<K...>){
+  return {{ step_range_k<K>... }};
+}
+static constexpr array<StepRange, K_COUNT> KERNELS = kernel_table(make_index_sequence<K_COUNT>());
+
+// The config only changes on a hotkey, the menu or a replayed key, so the stepper is
+// re-resolved once per frame and every glyph after that runs branch-free on it.
+static StepRange kernel(){ return KERNELS[kernel_key()]; }
+
+// Drawn cells, oldest first, for LIMIT_ERASE. A per-cell serial tells whether a
+// cell was redrawn since, so only its latest draw is ever erased. Memory follows
+// the canvas, not the limit: once a queue fills twice its cells, entries for
+// redrawn cells are dropped, leaving at most one per cell.
+struct Trail {
+  struct Entry { uint32_t cell; long long serial; };
+  uint32_t c0=0, c1=0;       // cells [c0,c1) of the canvas
+  vector<Entry> q;
+  size_t head=0;
+  vector<long long> stamp;   // serial+1 of the visible draw per cell, 0 = none
+  void reset(uint32_t a, uint32_t b){
+    c0=a; c1=b; head=0;
+    q.clear(); q.reserve(2*(size_t)(b-a) + 64);
+    stamp.assign(b-a, 0);
+  }
+  bool live(const Entry& e) const { return stamp[e.cell-c0]==e.serial+1; }
+  void compact(){
+    size_t k=0;
+    for (size_t i=head;i<q.size();i++) if (live(q[i])) q[k++]=q[i];
+    q.resize(k); head=0;
+  }
+  void push(uint32_t c, long long serial){
+    if (q.size()==q.capacity()) compact();
+    q.push_back(Entry{c, serial});
+    stamp[c-c0]=serial+1;
+  }
+  // Forget every visible draw older than 'before', oldest first; blank(cell) erases it.
+  template <class F> void expire(long long before, F&& blank){
+    while (head<q.size() && q[head].serial<before){
+      const Entry e=q[head++];
+      if (!live(e)) continue;
+      stamp[e.cell-c0]=0;
+      blank(e.cell);
+    }
+  }
+};
+
+// The canvas cut into bands for the settle pass: band b owns cells [b*span, (b+1)*span),
+// span a whole number of 64-cell occupancy words, so no two bands share a word. Each band
+// keeps its own trail; serials are global, so together they expire exactly the draws one
+// queue would.
+struct Bands {
+  int W=0, H=0;
+  size_t span=64;
+  vector<Trail> trail;
+  size_t of(uint32_t c) const { return c/span; }
+  void reset(int w, int h, size_t n){
+    const size_t cells=(size_t)w*h;
+    W=w; H=h; span=max<size_t>(64, ((cells+n-1)/n + 63) & ~(size_t)63);
+    trail.resize(n);
+    for (size_t b=0;b<n;b++) trail[b].reset((uint32_t)min(cells, b*span), (uint32_t)min(cells, (b+1)*span));
+  }
+  // New canvas size or band count; live draws carry over in serial order, cropped cells are forgotten.
+  void fit(int w, int h, size_t n){
+    if (w==W && h==H && n==trail.size()) return;
+    vector<Trail::Entry> live;
+    for (const Trail& t: trail)
+      for (size_t i=t.head;i<t.q.size();i++){
+        const Trail::Entry e=t.q[i];
+        const int x=(int)(e.cell%W), y=(int)(e.cell/W);
+        if (x<w && y<h && t.live(e)) live.push_back(Trail::Entry{(uint32_t)y*w+x, e.serial});
+      }
+    sort(live.begin(), live.end(), [](const Trail::Entry& a, const Trail::Entry& b){ return a.serial<b.serial; });
+    reset(w, h, n);
+    for (const Trail::Entry& e: live) trail[of(e.cell)].push(e.cell, e.serial);
+  }
+};
+static Bands bands;
+
+// Record the puts since 'from' and blank every cell whose draw has fallen more
+// than cfg.limit draws behind. Per-frame cost tracks the pipe count.
+static void erase_oldest(size_t from){
+  bands.fit(term.W, term.H, max<size_t>(1, bands.trail.size()));
+  const int W=bands.W, H=bands.H;
+  const size_t end=pending.puts.size();
+  for (size_t k=from;k<end;k++,drawn++){
+    const Put& p=pending.puts[k];
+    if (p.x>=W || p.y>=H) continue;
+    const uint32_t c=(uint32_t)p.y*W+p.x;
+    bands.trail[bands.of(c)].push(c, drawn);
+  }
+  for (Trail& t: bands.trail) t.expire(drawn-cfg.limit, [&](uint32_t c){ pending.put((int)(c%W), (int)(c/W), Cell{}); });
+}
+
+// What the canvas shows, as the puts so far leave it; occupancy mirrors its non-blank cells.
+static vector<Cell> shadow;
+
+static void reshape_canvas(int w, int h){
+  vector<Cell> n((size_t)w*h);
+  const int ow=occupancy.W;
+  for (int y=0;y<min(h, occupancy.H);y++) copy_n(shadow.begin()+(size_t)y*ow, min(w, ow), n.begin()+(size_t)y*w);
+  shadow.swap(n);
+  occupancy.reset(w, h);
+  for (size_t i=0;i<shadow.size();i++) if (shadow[i].glyph) occupancy.set(i, true);
+}
+
+// Fold one put into the shadow and the occupancy bits; false if it leaves its cell as it was.
+// The change in covered cells adds up in 'covered' (workers own disjoint words, not the count).
+static inline bool fold(const Put& p, int W, int H, long long& covered){
+  if (p.x>=W || p.y>=H) return true;
+  const size_t i=(size_t)p.y*W+p.x;
+  Cell& c=shadow[i];
+  if (c==p.c) return false;
+  if (!c.glyph != !p.c.glyph) covered+=occupancy.mark(i, p.c.glyph!=0);
+  c=p.c;
+  return true;
+}
+
+// Fold puts [from, end) into the shadow and the occupancy map, dropping each one that
+// leaves its cell as it was.
+static void track(size_t from){
+  if (occupancy.W!=term.W || occupancy.H!=term.H) reshape_canvas(term.W, term.H);
+  const int W=occupancy.W, H=occupancy.H;
+  Put* q=pending.puts.data();
+  size_t k=from;
+  long long covered=0;
+  for (size_t j=from, e=pending.puts.size(); j<e; j++) if (fold(q[j], W, H, covered)) q[k++]=q[j];
+  pending.puts.resize(k);
+  occupancy.covered=(size_t)((long long)occupancy.covered + covered);
+}
+
+static void clear_canvas(){
+  fill(shadow.begin(), shadow.end(), Cell{});
+  occupancy.reset(occupancy.W, occupancy.H);
+}
+
+// Where a LIMIT_CLEAR batch of n new puts clears: returns how many of them go with it
+// (0 = no clear) and moves last_reset. 'drawn' is still the count before the batch.
+static long long clear_cut(long long n, long long& last_reset){
+  if (cfg.limitMode!=LIMIT_CLEAR || cfg.limit<=0 || n<=0 || (drawn - last_reset) + n < cfg.limit) return 0;
+  const long long first=max(1LL, cfg.limit-(drawn-last_reset)); // 1-based put that triggers a clear
+  const long long last=first + (n-first)/cfg.limit*cfg.limit;  // last clear in this batch
+  last_reset=drawn+last;
+  return last;
+}
+
+// LIMIT_COVER: clear once the covered share of the canvas reaches cfg.coverPct.
+static void cover_check(long long& last_reset){
+  if (cfg.limitMode==LIMIT_COVER && cfg.coverPct>0 && occupancy.coverage()>=cfg.coverPct){
+    pending.clear(); clear_canvas(); last_reset=drawn;
+  }
+}
+
+// Account for the puts appended to pending since 'from'. LIMIT_CLEAR clears after
+// every limit-th draw, so only puts after the last clear survive; LIMIT_COVER clears
+// once the covered share of the canvas reaches cfg.coverPct.
+static void settle(size_t from, long long& last_reset){
+  if (cfg.limit>0 && cfg.limitMode==LIMIT_ERASE){ erase_oldest(from); track(from); return; }
+  const long long n=(long long)(pending.puts.size()-from);
+  if (const long long cut=clear_cut(n, last_reset)){
+    pending.puts.erase(pending.puts.begin(), pending.puts.begin()+(long)(from+cut));
+    pending.wipe=true;
+    clear_canvas();
+    from=0;
+  }
+  drawn+=n;
+  track(from);
+  cover_check(last_reset);
+}
+
+// Worker pool for large pipe sets, two passes per frame. First, slices of the pipe set
+// step in parallel into per-slice buffers, and each slice sorts its puts into per-band
+// buckets tagged with their position in the frame. Then the bands settle in parallel,
+// each against its own trail and its own cells of the shadow and the occupancy bits,
+// taking its buckets in slice order: every cell sees its puts in pipe order, as in a
+// sequential run (two pipes on one cell: the higher index wins). Bands share no cells,
+// so the caller only concatenates what each band kept.
+struct StepPool {
+  struct Tagged { Put p; uint32_t at; };     // at: position among the frame's puts
+  vector<thread> th;
+  mutex m;
+  condition_variable go, done;
+  uint64_t gen=0;
+  int busy=0;
+  bool quit=false;
+  bool settling=false;                       // which pass the workers run
+  Pipes* P=nullptr;
+  size_t n=0, parts=0;
+  StepRange step=nullptr;
+  vector<vector<Put>> buf;                   // per slice
+  vector<vector<vector<Tagged>>> bucket;     // [slice][band]
+  vector<size_t> off;                        // frame position of each slice's first put
+  vector<vector<Put>> kept;                  // per band: the puts that change the canvas
+  vector<long long> covered;                 // per band: change in covered cells
+  bool erase=false;
+  long long serial0=0, before=0;             // serial of the frame's first put; erase cutoff
+  size_t cut=0;                              // frame positions below this went with a clear
+
+  ~StepPool(){
+    { lock_guard<mutex> lk(m); quit=true; }
+    go.notify_all();
+    for (auto& t: th) t.join();
+  }
+  void slice(size_t k){
+    const size_t per=(n/parts+7)&~(size_t)7;   // keep 8-lane batches intact
+    const size_t b=min(n, k*per), e=(k+1==parts)? n: min(n, b+per);
+    vector<Put>& out=buf[k];
+    out.clear();
+    step(*P, b, e, out);
+    vector<vector<Tagged>>& bk=bucket[k];
+    // Every pipe puts once per step: sized for the whole slice, a bucket never grows mid-run.
+    for (auto& v: bk){ v.clear(); v.reserve(out.size()); }
+    for (size_t j=0;j<out.size();j++){
+      const Put& p=out[j];
+      const size_t band=(p.x<bands.W && p.y<bands.H) ? bands.of((uint32_t)p.y*bands.W+p.x) : 0;
+      bk[band].push_back(Tagged{p, (uint32_t)j});
+    }
+  }
+  void band(size_t b){
+    const int W=bands.W, H=bands.H;
+    Trail& t=bands.trail[b];
+    vector<Put>& out=kept[b];
+    out.clear();
+    out.reserve(n + (t.c1-t.c0));              // every put here plus a blank per cell
+    long long cov=0;
+    for (size_t k=0;k<parts;k++)
+      for (const Tagged& e: bucket[k][b]){
+        const size_t at=off[k]+e.at;
+        if (at<cut) continue;
+        if (erase && e.p.x<W && e.p.y<H) t.push((uint32_t)e.p.y*W+e.p.x, serial0+(long long)at);
+        if (fold(e.p, W, H, cov)) out.push_back(e.p);
+      }
+    if (erase)
+      t.expire(before, [&](uint32_t c){
+        const Put p{(uint16_t)(c%W), (uint16_t)(c/W), Cell{}};
+        if (fold(p, W, H, cov)) out.push_back(p);
+      });
+    covered[b]=cov;
+  }
+  void worker(size_t k){
+    uint64_t seen=0;
+    while (true){
+      unique_lock<mutex> lk(m);
+      go.wait(lk, [&]{ return quit || gen!=seen; });
+      if (quit) return;
+      seen=gen;
+      const bool mine = k<parts;
+      const bool second = settling;
+      lk.unlock();
+      if (mine){ if (second) band(k); else slice(k); }
+      lk.lock();
+      if (--busy==0) done.notify_one();
+    }
+  }
+  // One pass over parts 0..parts-1: part 0 on the caller, the rest on the workers.
+  void pass(bool second){
+    {
+      lock_guard<mutex> lk(m);
+      settling=second; busy=(int)th.size(); ++gen;
+    }
+    go.notify_all();
+    if (second) band(0); else slice(0);
+    unique_lock<mutex> lk(m);
+    done.wait(lk, [&]{ return busy==0; });
+  }
+  void run(Pipes& pipes, size_t want, StepRange fn, long long& last_reset){
+    while (th.size()+1 < want) th.emplace_back(&StepPool::worker, this, th.size()+1);
+    if (buf.size()<want){ buf.resize(want); kept.resize(want); covered.resize(want); off.resize(want); }
+    if (bucket.size()!=want) bucket.assign(want, vector<vector<Tagged>>(want));
+    P=&pipes; n=pipes.size(); parts=want; step=fn;
+    bands.fit(term.W, term.H, want);
+    pass(false);
+
+    size_t total=0;
+    for (size_t k=0;k<want;k++){ off[k]=total; total+=buf[k].size(); }
+    if (occupancy.W!=term.W || occupancy.H!=term.H) reshape_canvas(term.W, term.H);
+    erase=cfg.limit>0 && cfg.limitMode==LIMIT_ERASE;
+    serial0=drawn; before=drawn+(long long)total-cfg.limit;
+    cut=(size_t)clear_cut((long long)total, last_reset);
+    if (cut){ pending.puts.clear(); pending.wipe=true; clear_canvas(); }
+    drawn+=(long long)total;
+    pass(true);
+
+    long long cov=0;
+    pending.puts.reserve(pending.puts.size() + n + (size_t)bands.W*bands.H);   // what the bands can keep at most
+    for (size_t b=0;b<want;b++){ pending.puts.insert(pending.puts.end(), kept[b].begin(), kept[b].end()); cov+=covered[b]; }
+    occupancy.covered=(size_t)((long long)occupancy.covered + cov);
+    cover_check(last_reset);
+  }
+};
+
+void step_all(Pipes& P, long long& last_reset){
+  static StepPool pool;
+  const size_t n=P.size();
+  const size_t from=pending.puts.size();
+  // Slices below ~512 pipes cost more in handoff than they save.
+  const size_t want=min<size_t>((size_t)max(1,cfg.threads), n/512);
+  const StepRange step=kernel();
+  if (want<=1){ step(P, 0, n, pending.puts); settle(from, last_reset); }
+  else pool.run(P, want, step, last_reset);
+}
+
+Pipes spawn_pipes(){
+  bands.reset(term.W, term.H, 1);
+  occupancy.reset(0, 0); shadow.clear();
+  reshape_canvas(term.W, term.H);
+  asciiGlyphs = all_of(activeTypes.begin(), activeTypes.end(), [](int t){
+    return all_of(begin(T[t].g), end(T[t].g), [](const Glyph& g){ return g.n==1; });
+  });
+  Pipes P; P.resize((size_t)cfg.p);
+  Rng g; g.seed(cfg.seed, 0);
+  for (size_t i=0;i<P.size();i++){
+    State s;
+    s.rng.seed(cfg.seed, i+1);
+    s.colorIndex = palette[g.below((uint32_t)palette.size())];
+    s.typeIndex  = (int)g.below((uint32_t)activeTypes.size());
+    s.in = (Direction)g.below(4);
+    if (cfg.randomStart){ s.x=(int)g.below((uint32_t)term.W); s.y=(int)g.below((uint32_t)term.H); }
+    else { s.x=term.W/2; s.y=term.H/2; }
+    P.set(i, s);
+  }
+  return P;
+}
@@ -0,0 +1,192 @@
+// core.hpp — pipe simulation: directions, glyph sets, config, pipe state and stepping
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "term.hpp"
+
+// Directions
+enum Direction { UP=0, RIGHT=1, DOWN=2, LEFT=3 };
+inline Direction turn_left(Direction d){ return (Direction)((d+3)%4); }
+inline Direction turn_right(Direction d){ return (Direction)((d+1)%4); }
+
+// Per-pipe PRNG: xoshiro128** seeded through splitmix64. Streams are independent
+// per (seed, stream), so a seed plus config reproduces a run bit for bit.
+struct Rng {
+  uint32_t s[4]={1,2,3,4};
+  static uint64_t mix(uint64_t v){
+    v=(v^(v>>30))*0xBF58476D1CE4E5B9ULL; v=(v^(v>>27))*0x94D049BB133111EBULL;
+    return v^(v>>31);
+  }
+  // Each stream starts its splitmix sequence at a hash of its index: streams spaced one
+  // increment apart would share words, as every stream takes two.
+  void seed(uint64_t seed, uint64_t stream){
+    uint64_t z=seed ^ mix(stream + 0x9E3779B97F4A7C15ULL);
+    for (int i=0;i<4;i+=2){
+      const uint64_t v=mix(z+=0x9E3779B97F4A7C15ULL);
+      s[i]=(uint32_t)v; s[i+1]=(uint32_t)(v>>32);
+    }
+    if (!(s[0]|s[1]|s[2]|s[3])) s[0]=1;
+  }
+  static uint32_t rotl(uint32_t x, int k){ return (x<<k) | (x>>(32-k)); }
+  uint32_t next(){
+    const uint32_t r=rotl(s[1]*5, 7)*9, t=s[1]<<9;
+    s[2]^=s[0]; s[3]^=s[1]; s[1]^=s[2]; s[0]^=s[3]; s[2]^=t; s[3]=rotl(s[3], 11);
+    return r;
+  }
+  // Unbiased draw in [0,n) (Lemire); r holds the accepted raw word so callers
+  // can spend its low bits on further decisions.
+  uint32_t below(uint32_t n, uint32_t& r){
+    uint64_t m=(uint64_t)(r=next())*n;
+    if ((uint32_t)m < n){
+      const uint32_t t=(0u-n)%n;
+      while ((uint32_t)m < t) m=(uint64_t)(r=next())*n;
+    }
+    return (uint32_t)(m>>32);
+  }
+  uint32_t below(uint32_t n){ uint32_t r; return below(n, r); }
+};
+
+// Glyph types: 16 UTF-8 glyphs per set, indexed by turn (in*4 + out)
+struct Glyph {
+  char b[4]{};
+  uint8_t n=0;
+};
+constexpr Glyph glyph(const char* s){
+  Glyph g{};
+  while (s[g.n] && g.n<4){ g.b[g.n]=s[g.n]; ++g.n; }
+  return g;
+}
+struct PipeType { Glyph g[16]{}; };
+constexpr PipeType pipe_type(const char* const (&s)[16]){
+  PipeType t{};
+  for (int k=0;k<16;k++) t.g[k]=glyph(s[k]);
+  return t;
+}
+// Built-in sets; T starts as a copy and stays writable for -t c. The sets from
+// TEXT_TYPE on are not pipes: they hold printable ASCII for text laid over the canvas.
+constexpr int TEXT_TYPE = 10, TYPE_SLOTS = 16;
+extern const PipeType BUILTIN_TYPES[10];
+extern PipeType T[TYPE_SLOTS];
+void init_types();
+
+// Turn index: (in -> out) -> 1..16; a reversal draws as straight.
+constexpr int8_t TURN_IDX[4][4] = {
+  /* UP    */ { 1,  2,  1,  4},
+  /* RIGHT */ { 5,  6,  7,  6},
+  /* DOWN  */ {11, 10, 11, 12},
+  /* LEFT  */ {13, 16, 15, 16},
+};
+inline int idx_from(Direction in, Direction out){ return TURN_IDX[in][out]; }
+
+// What the draw limit does: erase the oldest cells as new ones land, clear the screen,
+// or clear it once cfg.coverPct percent of the canvas shows a pipe.
+enum LimitMode { LIMIT_ERASE, LIMIT_CLEAR, LIMIT_COVER };
+
+// Config (defaults)
+struct Config {
+  int p=8;
+  int fps=100;
+  int maxFps=100;
+  int straight=15;
+  long long limit=1000;
+  LimitMode limitMode=LIMIT_ERASE;
+  int coverPct=90;         // LIMIT_COVER threshold
+  bool avoid=false;        // steer into free cells when one is at hand
+  bool randomStart=true;
+  bool noBold=true;
+  bool noColor=false;
+  bool keepOnEdge=true;
+  bool vivid=true;
+  bool catchUp=false;
+  uint64_t seed=0;
+  bool simd=true;          // batched step kernel; off forces the scalar path
+  int threads=1;           // simulation workers (large pipe sets only)
+};
+extern Config cfg;
+
+extern std::vector<int> activeTypes;
+extern std::vector<int> palette;
+
+// SGR foreground for a palette entry, resolved against the current color config
+inline uint8_t fg_code(int c){
+  if (cfg.noColor) return 39;
+  return (uint8_t)((cfg.vivid ? 90 : 30) + (c & 7));
+}
+
+// Pipe state
+struct State {
+  int x=0, y=0;
+  Direction in=RIGHT, out=RIGHT;
+  int colorIndex=1;
+  int typeIndex=0;
+  Rng rng;
+};
+
+inline bool would_exit(const State& s, Direction nd){
+  int nx=s.x, ny=s.y;
+  if (nd==UP) --ny; else if (nd==DOWN) ++ny; else if (nd==LEFT) --nx; else ++nx;
+  return nx<0 || nx>=term.W || ny<0 || ny>=term.H;
+}
+
+// Pipe set as structure of arrays; 32-bit lanes so the batch kernel loads them directly.
+struct Pipes {
+  std::vector<int32_t> x, y, in, out, color, type;
+  std::vector<uint32_t> s0, s1, s2, s3;     // xoshiro128** state per pipe
+  size_t size() const { return x.size(); }
+  void resize(size_t n){
+    for (auto* v: {&x,&y,&in,&out,&color,&type}) v->resize(n);
+    for (auto* v: {&s0,&s1,&s2,&s3}) v->resize(n);
+  }
+  State get(size_t i) const {
+    State s; s.x=x[i]; s.y=y[i]; s.in=(Direction)in[i]; s.out=(Direction)out[i];
+    s.colorIndex=color[i]; s.typeIndex=type[i];
+    s.rng.s[0]=s0[i]; s.rng.s[1]=s1[i]; s.rng.s[2]=s2[i]; s.rng.s[3]=s3[i];
+    return s;
+  }
+  void set(size_t i, const State& s){
+    x[i]=s.x; y[i]=s.y; in[i]=s.in; out[i]=s.out; color[i]=s.colorIndex; type[i]=s.typeIndex;
+    s0[i]=s.rng.s[0]; s1[i]=s.rng.s[1]; s2[i]=s.rng.s[2]; s3[i]=s.rng.s[3];
+  }
+};
+
+// Canvas occupancy: one bit per cell, set while it shows a pipe glyph. The covered
+// count moves with every bit flip, so coverage is an O(1) read.
+struct Occupancy {
+  int W=0, H=0;
+  std::vector<uint64_t> bits;
+  size_t covered=0;
+  void reset(int w, int h){ W=w; H=h; bits.assign(((size_t)w*h+63)/64, 0); covered=0; }
+  bool test(size_t i) const { return (bits[i>>6]>>(i&63)) & 1; }
+  bool test(int x, int y) const { return x>=0 && y>=0 && x<W && y<H && test((size_t)y*W+x); }
+  // Flip cell i to 'on' and return the change in covered without applying it, for
+  // writers on disjoint words that sum their changes afterwards.
+  int mark(size_t i, bool on){
+    uint64_t& w=bits[i>>6];
+    const uint64_t m=1ull<<(i&63);
+    if (((w&m)!=0)==on) return 0;
+    w^=m;
+    return on ? 1 : -1;
+  }
+  void set(size_t i, bool on){ const int d=mark(i, on); if (d>0) ++covered; else if (d<0) --covered; }
+  // Percent of the canvas covered.
+  double coverage() const { return W && H ? 100.0*(double)covered/((double)W*H) : 0; }
+};
+extern Occupancy occupancy;
+
+// Step: decide -> draw (into the pending frame) -> move
+extern long long drawn;
+// Step every pipe once, batched 8 at a time when SIMD is available and split
+// across cfg.threads workers for large sets; the draw limit erases the oldest
+// cells or clears the pending frame. Each cell sees its puts in pipe order either way, so output does not depend on either.
+// Puts that would redraw a cell exactly as it is are dropped. Each frame runs the
+// kernel compiled for the current keepOnEdge/avoid/color/vivid/bold combination.
+void step_all(Pipes& P, long long& last_reset);
+// Pipes for the current canvas, seeded from cfg.seed (stream 0 places them, stream i+1 drives pipe i).
+// Also starts the canvas bookkeeping (trail, occupancy) afresh and sets the encoder's glyph width.
+Pipes spawn_pipes();
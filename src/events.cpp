@@ -0,0 +1,140 @@
+// events.cpp — input event loop (Linux epoll, POSIX poll, Windows fallback)
+
+#include "events.hpp"
+#include "term.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+  #include <conio.h>
+#else
+  #include <poll.h>
+  #include <signal.h>
+  #include <unistd.h>
+#endif
+#if defined(__linux__)
+  #include <sys/epoll.h>
+  #include <sys/signalfd.h>
+  #include <sys/timerfd.h>
+#endif
+
+using namespace std;
+
+Events events;
+
+void Events::readKeys(){
+  if (head==tail) head=tail=0;
+#ifdef _WIN32
+  while (tail<sizeof keys && _kbhit()) keys[tail++]=(char)_getch();
+#else
+  while (tail<sizeof keys){
+    const ssize_t n=::read(STDIN_FILENO, keys+tail, sizeof keys - tail);
+    if (n>0){ tail+=(size_t)n; continue; }
+    if (n<0 && errno==EINTR) continue;
+    break;   // EAGAIN: drained; 0: EOF
+  }
+#endif
+}
+
+#if defined(__linux__)
+
+void Events::init(){
+  sigset_t set; sigemptyset(&set); sigaddset(&set, SIGWINCH);
+  pthread_sigmask(SIG_BLOCK, &set, nullptr);
+  sfd=signalfd(-1, &set, SFD_NONBLOCK|SFD_CLOEXEC);
+  tfd=timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+  ep=epoll_create1(EPOLL_CLOEXEC);
+  for (int fd: {STDIN_FILENO, sfd, tfd}){
+    epoll_event e{}; e.events=EPOLLIN; e.data.fd=fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &e);
+  }
+}
+
+void Events::watch(int fd){
+  wfd=fd;
+  epoll_event e{}; e.events=EPOLLIN; e.data.fd=fd;
+  epoll_ctl(ep, EPOLL_CTL_ADD, fd, &e);
+}
+
+void Events::close(){
+  for (int* fd: {&ep, &sfd, &tfd}) if (*fd>=0){ ::close(*fd); *fd=-1; }
+  sigset_t set; sigemptyset(&set); sigaddset(&set, SIGWINCH);
+  pthread_sigmask(SIG_UNBLOCK, &set, nullptr);
+}
+
+unsigned Events::wait(clock::time_point deadline){
+  if (head<tail) return EV_KEY;
+  itimerspec its{};
+  if (deadline!=clock::time_point::max()){
+    const auto ns=max<long long>(1, chrono::duration_cast<chrono::nanoseconds>(deadline.time_since_epoch()).count());
+    its.it_value={ (time_t)(ns/1000000000LL), (long)(ns%1000000000LL) };
+  }
+  timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, nullptr);   // zero disarms
+
+  unsigned ev=0;
+  while (!ev){
+    epoll_event e[4];
+    const int n=epoll_wait(ep, e, 4, -1);
+    if (n<0){ if (errno==EINTR) continue; break; }
+    for (int i=0;i<n;i++){
+      const int fd=e[i].data.fd;
+      if (fd==STDIN_FILENO){
+        const size_t before=tail-head;
+        readKeys();
+        if (tail-head>before) ev|=EV_KEY;
+        else epoll_ctl(ep, EPOLL_CTL_DEL, STDIN_FILENO, nullptr);   // EOF: stop watching
+      } else if (fd==sfd){
+        signalfd_siginfo si;
+        while (::read(sfd, &si, sizeof si)==(ssize_t)sizeof si) {}
+        term.markResized(); ev|=EV_RESIZE;
+      } else if (fd==wfd){
+        ev|=EV_FD;
+      } else if (fd==tfd){
+        uint64_t expirations;
+        (void)!::read(tfd, &expirations, sizeof expirations);
+      }
+    }
+    if (clock::now()>=deadline) ev|=EV_TICK;
+  }
+  return ev;
+}
+
+#else
+
+void Events::init(){}
+void Events::close(){}
+void Events::watch(int fd){ wfd=fd; }
+
+unsigned Events::wait(clock::time_point deadline){
+  if (head<tail) return EV_KEY;
+  unsigned ev=0;
+  while (!ev){
+    // Capped so a SIGWINCH that lands just before the wait is still seen promptly.
+    const auto now=clock::now();
+    const long long ms= deadline<=now ? 0
+      : min<long long>(100, chrono::duration_cast<chrono::milliseconds>(deadline-now+chrono::microseconds(999)).count());
+#ifdef _WIN32
+    if (!_kbhit()) this_thread::sleep_for(chrono::milliseconds(min<long long>(ms, 5)));
+    readKeys();
+    if (head<tail) ev|=EV_KEY;
+#else
+    pollfd pfd[2]={{STDIN_FILENO, POLLIN, 0}, {wfd, POLLIN, 0}};
+    if (poll(pfd, wfd>=0 ? 2 : 1, (int)ms)>0){
+      if (pfd[1].revents & (POLLIN|POLLHUP)) ev|=EV_FD;
+      if (pfd[0].revents & (POLLIN|POLLHUP)){
+        readKeys();
+        if (head<tail) ev|=EV_KEY;
+        else if (!ev) this_thread::sleep_for(chrono::milliseconds(ms));   // EOF stays readable
+      }
+    }
+#endif
+    if (term.resizePending()) ev|=EV_RESIZE;
+    if (clock::now()>=deadline) ev|=EV_TICK;
+  }
+  return ev;
+}
+
+#endif
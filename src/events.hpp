@@ -0,0 +1,36 @@
+// events.hpp — input event loop: keys, resizes and frame deadlines from one wait
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+// One blocking wait multiplexes stdin, SIGWINCH and the next frame deadline.
+// Linux: epoll over stdin + signalfd + timerfd (absolute CLOCK_MONOTONIC).
+// Other POSIX: poll on stdin with a SIGWINCH handler; Windows: short sleeps + _kbhit.
+// One extra fd (a socket, say) can be watched alongside (POSIX only).
+struct Events {
+  using clock = std::chrono::steady_clock;
+  enum : unsigned { EV_KEY=1, EV_RESIZE=2, EV_TICK=4, EV_FD=8 };
+
+  // Call before starting any thread: SIGWINCH is blocked process-wide so only the signalfd sees it.
+  void init();
+  void close();
+  // Also wake with EV_FD while fd is readable; call after init().
+  void watch(int fd);
+  // Block until a key, a resize or the deadline (clock::time_point::max() = none).
+  // Keys are drained into the queue in bulk; a resize also marks the terminal.
+  unsigned wait(clock::time_point deadline);
+  // Next queued key, or -1.
+  int key(){ return head<tail ? (unsigned char)keys[head++] : -1; }
+
+  char keys[256];
+  size_t head=0, tail=0;
+  int wfd=-1;
+#if defined(__linux__)
+  int ep=-1, sfd=-1, tfd=-1;
+#endif
+private:
+  void readKeys();
+};
+extern Events events;
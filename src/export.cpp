@@ -0,0 +1,82 @@
+// export.cpp — asciicast v2 / ttyrec writers
+
+#include "export.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+
+static constexpr size_t EXPORT_CHUNK = 1u<<20;
+
+bool Exporter::open(const char* path, ExportFormat format, int W, int H, uint64_t seed){
+  f=fopen(path, "wb");
+  if (!f) return false;
+  setvbuf(f, nullptr, _IONBF, 0);   // buf already batches; skip stdio's copy
+  fmt=format; buf.resize(EXPORT_CHUNK); len=0;
+  epoch=(uint32_t)time(nullptr);
+  if (fmt==EXPORT_CAST){
+    char h[256];
+    const int n=snprintf(h, sizeof h,
+      "{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %u, "
+      "\"env\": {\"TERM\": \"xterm-256color\"}, \"title\": \"pipes seed %llu\"}\n",
+      W, H, epoch, (unsigned long long)seed);
+    put(h, (size_t)n);
+  }
+  return true;
+}
+
+void Exporter::put(const char* p, size_t n){
+  while (n){
+    if (len==buf.size()) flush();
+    const size_t k=min(n, buf.size()-len);
+    memcpy(buf.data()+len, p, k); len+=k; p+=k; n-=k;
+  }
+}
+
+void Exporter::flush(){
+  if (!len) return;
+  if (!failed && fwrite(buf.data(), 1, len, f)!=len) failed=true;
+  bytes+=(long long)len; ++writes;
+  len=0;
+}
+
+void Exporter::frame(double t, const char* p, size_t n){
+  if (!n) return;
+  if (fmt==EXPORT_TTYREC){
+    const double whole=floor(t);
+    const uint32_t v[3]={ epoch+(uint32_t)whole, (uint32_t)((t-whole)*1e6), (uint32_t)n };
+    char* h=room(12);
+    for (int i=0;i<3;i++) for (int k=0;k<4;k++) h[i*4+k]=(char)(v[i]>>(8*k));
+    len+=12;
+    put(p, n);
+    return;
+  }
+  char* o=room(32);
+  len+=(size_t)snprintf(o, 32, "[%.6f, \"o\", \"", t);
+  // JSON string body: UTF-8 passes through, controls become \u00XX.
+  static const char hex[]="0123456789abcdef";
+  for (size_t i=0;i<n;i++){
+    const unsigned char c=(unsigned char)p[i];
+    char* q=room(6);
+    if (c=='"' || c=='\\'){ q[0]='\\'; q[1]=(char)c; len+=2; }
+    else if (c<0x20){ memcpy(q, "\\u00", 4); q[4]=hex[c>>4]; q[5]=hex[c&15]; len+=6; }
+    else { q[0]=(char)c; ++len; }
+  }
+  put("\"]\n", 3);
+}
+
+void Exporter::resize(double t, int W, int H){
+  if (fmt!=EXPORT_CAST) return;   // ttyrec has no resize record
+  char* o=room(64);
+  len+=(size_t)snprintf(o, 64, "[%.6f, \"r\", \"%dx%d\"]\n", t, W, H);
+}
+
+bool Exporter::close(){
+  if (!f) return false;
+  flush();
+  if (fclose(f)!=0) failed=true;
+  f=nullptr;
+  return !failed;
+}
@@ -0,0 +1,35 @@
+// export.hpp — headless export: asciicast v2 or ttyrec streams of the frame diffs
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// asciicast v2: JSON header line, then [t, "o", "<bytes>"] per frame (plus "r" on resize).
+// ttyrec: per frame a little-endian sec/usec/len header and the raw bytes.
+enum ExportFormat { EXPORT_CAST, EXPORT_TTYREC };
+
+// Streams frames to a file through one fixed buffer written out in large chunks,
+// so memory stays flat however long the run.
+struct Exporter {
+  ExportFormat fmt=EXPORT_CAST;
+  FILE* f=nullptr;
+  std::vector<char> buf;
+  size_t len=0;
+  long long bytes=0, writes=0; // file totals
+  bool failed=false;
+  uint32_t epoch=0;            // ttyrec base time (unix seconds)
+
+  bool open(const char* path, ExportFormat format, int W, int H, uint64_t seed);
+  // One frame's output, shown t seconds into the recording.
+  void frame(double t, const char* p, size_t n);
+  void resize(double t, int W, int H);
+  // Flush and close; false if any write failed.
+  bool close();
+private:
+  char* room(size_t n){ if (len+n>buf.size()) flush(); return buf.data()+len; }
+  void put(const char* p, size_t n);
+  void flush();
+};
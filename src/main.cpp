@@ -1,246 +1,287 @@
 // pipes.cpp — pipes.sh-like clone with interactive pre-run menu (Windows/Linux)
 
 #include <algorithm>
-#include <array>
+#include <cmath>
+#include <atomic>
 #include <chrono>
-#include <csignal>
 #include <cstdio>
 #include <cstdlib>
-#include <cstring>
+#include <ctime>
 #include <exception>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
 
-#ifdef _WIN32
-  #include <windows.h>
-  #include <conio.h>
-#else
+#ifndef _WIN32
   #include <sys/ioctl.h>
   #include <unistd.h>
-  #include <termios.h>
   #include <fcntl.h>
-  #include <signal.h>
+  #include <poll.h>
 #endif
 
+#include "core.hpp"
+#include "events.hpp"
+#include "export.hpp"
+#include "metrics.hpp"
+#include "record.hpp"
+#include "render.hpp"
+#include "sched.hpp"
+#include "serve.hpp"
+#include "shm.hpp"
+#include "screen.hpp"
+#include "term.hpp"
+
 using namespace std;
 
-// Directions
-enum Direction { UP=0, RIGHT=1, DOWN=2, LEFT=3 };
-static inline int rnd(int n){ return rand()%n; }
-static inline void sleep_ms(int ms){ this_thread::sleep_for(chrono::milliseconds(ms)); }
-static inline Direction turn_left(Direction d){ return (Direction)((d+3)%4); }
-static inline Direction turn_right(Direction d){ return (Direction)((d+1)%4); }
+// Run statistics, fed by both threads and rolled once per METRICS_PERIOD; the I key
+// lays the latest window over the bottom row.
+static constexpr auto METRICS_PERIOD = chrono::seconds(1);
+static Metrics metrics;
+static Renderer renderer;
 
-// Terminal I/O 
+// Simulation ticks run so far; recorded events are pinned to it.
+static long long tick = 0;
+static Recorder rec;
 #ifndef _WIN32
-static bool g_resized=false;
-static void on_resize(int){ g_resized=true; }
+static Publisher pub;
 #endif
 
-struct Term {
-  int W=80, H=24;
-#ifdef _WIN32
-  HANDLE hout{}, hin{};
-  void enableVT(){
-    SetConsoleOutputCP(CP_UTF8);
-    SetConsoleCP(CP_UTF8);
-    DWORD m=0; hout=GetStdHandle(STD_OUTPUT_HANDLE);
-    if (GetConsoleMode(hout,&m)){ m|=ENABLE_VIRTUAL_TERMINAL_PROCESSING; SetConsoleMode(hout,m); }
-    hin = GetStdHandle(STD_INPUT_HANDLE);
+// A resize takes effect once SIGWINCH has been quiet this long (window drags send bursts).
+static constexpr auto RESIZE_SETTLE = chrono::milliseconds(50);
+
+// Settled resize: the next frame carries the new size and keeps the canvas;
+// pipes left outside it wrap back in and carry on in the same direction.
+static void apply_resize(Pipes& S){
+  pending.W=term.W; pending.H=term.H;
+  rec.resize(tick, term.W, term.H);
+  if (term.W<=0 || term.H<=0) return;
+  for (size_t i=0;i<S.size();i++){
+    if (S.x[i]>=term.W) S.x[i] %= term.W;
+    if (S.y[i]>=term.H) S.y[i] %= term.H;
   }
-#else
-  termios oldt{};
-#endif
-  void init(){
-#ifdef _WIN32
-    enableVT();
-#else
-    signal(SIGWINCH, on_resize);
-    tcgetattr(STDIN_FILENO,&oldt);
-    termios raw=oldt; raw.c_lflag &= ~(ICANON|ECHO);
-    tcsetattr(STDIN_FILENO,TCSANOW,&raw);
-    int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
-    fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
+}
+
+// One simulation tick: step every pipe and hand the delta to the renderer.
+static void sim_tick(Pipes& S, long long& last_reset){
+  const size_t from=pending.puts.size();
+  const long long reset0=last_reset;
+  const auto t0=chrono::steady_clock::now();
+  step_all(S, last_reset); ++tick;
+  metrics.tick((uint64_t)chrono::nanoseconds(chrono::steady_clock::now()-t0).count());
+#ifndef _WIN32
+  // A clear in this tick dropped the puts before it: what is left is the whole canvas.
+  if (pub.base){ const bool cleared=last_reset!=reset0; pub.publish(pending, cleared ? 0 : from, cleared, S, tick, drawn); }
 #endif
-    updateSize();
-    hideCursor();
+  // A stalled renderer leaves the ring full: keep coalescing into the pending delta.
+  if (ring.push(pending)) renderer.wake();
+  else if (pending.puts.size() > (size_t)pending.W*pending.H) pending.compact();
+}
+
+// Hotkeys during run; false for an unbound key, which quits.
+static bool apply_key(int ch){
+  if      (ch=='P') cfg.straight = min(15, cfg.straight+1);
+  else if (ch=='O') cfg.straight = max(5,  cfg.straight-1);
+  else if (ch=='F') cfg.fps      = min(cfg.maxFps,cfg.fps+5);
+  else if (ch=='D') cfg.fps      = max(20, cfg.fps-5);
+  else if (ch=='B') cfg.noBold   = !cfg.noBold;
+  else if (ch=='C') cfg.noColor  = !cfg.noColor;
+  else if (ch=='K') cfg.keepOnEdge = !cfg.keepOnEdge;
+  else if (ch=='I'){ renderer.showStats.store(!renderer.showStats.load(memory_order_relaxed), memory_order_relaxed); renderer.wake(); }
+  else return false;
+  return true;
+}
+
+// Every key since the last wakeup is recorded and applied.
+static void handle_keys(){
+  for (int ch; (ch=events.key())!=-1;){
+    rec.key(tick, ch);
+    if (!apply_key(ch)) throw runtime_error("quit");
   }
-  void restore(){
-    showCursor();
+}
+
+// Replay position: the next logged event, consumed as the simulation reaches its tick.
+struct ReplayCursor {
+  Replay log;
+  RecEvent ev;
+  bool have=false;
+};
+
+// Apply every event due before tick t; false once the run ends (its quit key, REC_END or a cut-off log).
+static bool replay_due(ReplayCursor& rc, long long t, Pipes& S){
+  for (; rc.have && rc.ev.tick<=t; rc.have=rc.log.next(rc.ev)){
+    if (rc.ev.kind==REC_END) return false;
+    if (rc.ev.kind==REC_KEY){ if (!apply_key(rc.ev.key)) return false; }
+    else { term.W=rc.ev.W; term.H=rc.ev.H; apply_resize(S); }
+  }
+  return rc.have;
+}
+
+// Headless benchmark: no tty, no sleeping; simulate, encode and commit back-to-back.
+struct Bench {
+  long long frames=0, steps=0;  // run length: frames, or pipe steps when set
+  string sink="null";
+  int W=80, H=24;
+  ReplayCursor* replay=nullptr;   // run a recording instead of a fixed length
+};
+
 #ifndef _WIN32
-    tcsetattr(STDIN_FILENO,TCSANOW,&oldt);
-    int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
-    fcntl(STDIN_FILENO, F_SETFL, flags & ~O_NONBLOCK);
+// Open a pty pair sized W x H; a drain thread keeps the master side empty.
+static int open_bench_pty(int W, int H, int& master){
+  master=posix_openpt(O_RDWR|O_NOCTTY);
+  if (master<0 || grantpt(master)!=0 || unlockpt(master)!=0) return -1;
+  const char* name=ptsname(master);
+  int slave = name ? open(name, O_RDWR|O_NOCTTY) : -1;
+  if (slave<0) return -1;
+  winsize ws{}; ws.ws_col=(unsigned short)W; ws.ws_row=(unsigned short)H;
+  ioctl(slave, TIOCSWINSZ, &ws);
+  return slave;
+}
 #endif
-  }
-  void updateSize(){
-#ifdef _WIN32
-    CONSOLE_SCREEN_BUFFER_INFO csbi;
-    GetConsoleScreenBufferInfo(hout,&csbi);
-    W = csbi.srWindow.Right - csbi.srWindow.Left + 1;
-    H = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
-#else
-    winsize w{}; ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
-    W = w.ws_col; H = w.ws_row;
+
+static int run_bench(const Bench& b){
+  term.W=b.W; term.H=b.H;
+  Out& out=term.out;
+#ifndef _WIN32
+  int master=-1;
+  thread drain;
+  atomic<bool> draining{true};
 #endif
+  if      (b.sink=="null") out.sink=SINK_NULL;
+  else if (b.sink=="mem")  out.sink=SINK_MEM;
+#ifndef _WIN32
+  else if (b.sink=="devnull"){ out.sink=SINK_FD; out.fd=open("/dev/null", O_WRONLY); }
+  else if (b.sink=="pty"){
+    out.sink=SINK_FD; out.fd=open_bench_pty(b.W, b.H, master);
+    if (out.fd>=0) drain=thread([&]{
+      char junk[1<<16];
+      while (draining.load(memory_order_relaxed)){
+        pollfd pfd{master,POLLIN,0};
+        if (poll(&pfd,1,50)>0 && read(master,junk,sizeof junk)<=0) break;
+      }
+    });
   }
-  bool checkResize(){
-#ifdef _WIN32
-    int ow=W, oh=H; updateSize();
-    if (ow!=W || oh!=H){ clear(); return true; }
-    return false;
-#else
-    if (g_resized){ g_resized=false; updateSize(); clear(); return true; }
-    return false;
 #endif
-  }
-  void clear(){ cout << "\033[2J\033[H" << flush; }
-  void mv(int x,int y){ cout << "\033[" << (y+1) << ";" << (x+1) << "H"; }
-  void hideCursor(){ cout << "\033[?25l"; }
-  void showCursor(){ cout << "\033[?25h"; }
-  bool kbhit(){
-#ifdef _WIN32
-    return _kbhit();
-#else
-    int ch = getchar();
-    if (ch!=EOF){ ungetc(ch,stdin); return true; }
-    return false;
+  else { cerr << "Error: unknown sink '" << b.sink << "' (null, mem, devnull, pty).\n"; return 1; }
+#ifndef _WIN32
+  if (out.sink==SINK_FD && out.fd<0){ cerr << "Error: cannot open " << b.sink << " sink.\n"; return 1; }
 #endif
+
+  Pipes S = spawn_pipes();
+  long long frames = b.replay ? 0 : b.steps>0 ? (b.steps + cfg.p - 1)/cfg.p : max(1LL, b.frames);
+  Histogram enc;                    // encode times: fixed size however many frames run
+  pending.W=b.W; pending.H=b.H;
+  long long last_reset=0;
+  using clk=chrono::steady_clock;
+  double simT=0, encT=0, wrT=0;
+  const long long drawn0=drawn;
+  const auto t0=clk::now();
+  for (long long f=0; b.replay || f<frames; f++){
+    if (b.replay && !replay_due(*b.replay, f, S)){ frames=f; break; }
+    const auto a=clk::now();
+    step_all(S, last_reset);
+    const auto m=clk::now();
+    term.syncBegin();
+    apply_frame(pending); pending.reset();
+    screen.flush();
+    term.syncEnd();
+    const auto e=clk::now();
+    out.commit();
+    const auto w=clk::now();
+    simT+=chrono::duration<double>(m-a).count();
+    encT+=chrono::duration<double>(e-m).count();
+    wrT +=chrono::duration<double>(w-e).count();
+    enc.add((uint64_t)chrono::nanoseconds(e-m).count());
   }
-  int getch_now(){
-#ifdef _WIN32
-    return _getch();
-#else
-    int ch = getchar();
-    return (ch==EOF)? -1 : ch;
+  const double total=chrono::duration<double>(clk::now()-t0).count();
+#ifndef _WIN32
+  draining=false;
+  if (drain.joinable()) drain.join();
+  if (out.fd>=0) close(out.fd);
+  if (master>=0) close(master);
 #endif
-  }
-} term;
-
-// Glyph types (16-entry table) 
-struct PipeType { array<string,16> g{}; };
-static PipeType T[10];
-
-static void init_types(){
-  T[0].g = { "┃","┏"," ","┓","┛","━","┓"," "," ","┗","┃","┛","┗"," ","┏","━" };
-  T[1].g = { "│","╭"," ","╮","╯","─","╮"," "," ","╰","│","╯","╰"," ","╭","─" };
-  T[2].g = { "│","┌"," ","┐","┘","─","┐"," "," ","└","│","┘","└"," ","┌","─" };
-  T[3].g = { "║","╔"," ","╗","╝","═","╗"," "," ","╚","║","╝","╚"," ","╔","═" };
-  T[4].g = { "|","+"," ","+","+","-","+"," "," ","+","|","+","+"," ","+","-" };
-  T[5].g = { "|","/"," ","\\","\\","-","\\"," "," ","\\","|","\\","/"," ","/","-" };
-  T[6].g = { ".","."," ",".",".",".","."," "," ",".",".",".","."," ",".","."
-  };
-  T[7].g = { ".","o"," ","o","o",".","o"," "," ","o",".","o","o"," ","o","." };
-  T[8].g = { "|","-"," ","|","\\","-","\\"," "," ","\\","|","/","/"," ","-","-" };
-  T[9].g = { "╿","┎"," ","┒","┛","╾","┒"," "," ","┖","╿","┛","┖"," ","┎","╾" };
-}
 
-// Turn index: (in -> out) -> 1..16 
-static inline int idx_from(Direction in, Direction out){
-  if (in==UP   && out==UP)    return 1;
-  if (in==UP   && out==RIGHT) return 2;
-  if (in==UP   && out==LEFT)  return 4;
-  if (in==RIGHT&& out==UP)    return 5;
-  if (in==RIGHT&& out==RIGHT) return 6;
-  if (in==RIGHT&& out==DOWN)  return 7;
-  if (in==DOWN && out==RIGHT) return 10;
-  if (in==DOWN && out==DOWN)  return 11;
-  if (in==DOWN && out==LEFT)  return 12;
-  if (in==LEFT && out==UP)    return 13;
-  if (in==LEFT && out==DOWN)  return 15;
-  if (in==LEFT && out==LEFT)  return 16;
-  if (in==UP||in==DOWN) return (in==UP?1:11);
-  return (in==RIGHT?6:16);
+  const long long steps=drawn-drawn0;
+  const double p50=(double)enc.quantile(0.50)/1e3, p99=(double)enc.quantile(0.99)/1e3;
+  char line[160];
+  auto row=[&](const char* k, double v, const char* unit, int prec=3){
+    snprintf(line, sizeof line, "  %-14s %14.*f%s%s\n", k, prec, v, *unit? " ":"", unit); cout << line;
+  };
+  cout << "bench: " << b.W << "x" << b.H << "  pipes " << cfg.p << "  type " << activeTypes.front()
+       << "  color " << (cfg.noColor? "off":"on") << "  sink " << b.sink << "  seed " << cfg.seed
+       << "  threads " << cfg.threads << "\n";
+  row("frames",       (double)frames, "", 0);
+  row("steps",        (double)steps, "", 0);
+  row("time",         total, "s");
+  row("steps/s",      steps/total, "", 0);
+  row("frames/s",     frames/total, "", 0);
+  row("bytes/step",   steps? (double)out.bytes/steps: 0, "B");
+  frames=max(1LL, frames);
+  row("bytes/frame",  (double)out.bytes/frames, "B");
+  row("writes/frame", (double)out.writes/frames, "");
+  row("sim/frame",    simT*1e6/frames, "us");
+  row("encode/frame", encT*1e6/frames, "us");
+  row("write/frame",  wrT*1e6/frames, "us");
+  row("encode p50",   p50, "us");
+  row("encode p99",   p99, "us");
+  return 0;
 }
 
-// Config (defaults) 
-struct Config {
-  int p=8;
-  int fps=100;
-  int straight=15;
-  long long limit=1000;
-  bool randomStart=true;
-  bool noBold=true;
-  bool noColor=false;
-  bool keepOnEdge=true;
-  bool vivid=true;
-} cfg;
-
-static vector<int> activeTypes;
-static vector<int> palette;
-
-static inline string ansi_color(int c){
-  if (cfg.noColor) return "";
-  const int base = cfg.vivid ? 90 : 30;
-  const int code = base + (c & 7);
-  return "\033[" + to_string(code) + "m";
-}
-static inline string ansi_reset(){ return cfg.noColor ? "" : "\033[0m"; }
-
-// Pipe state 
-struct State {
-  int x=0, y=0;
-  Direction in=RIGHT, out=RIGHT;
-  int colorIndex=1;
-  int typeIndex=0;
+// Export: headless like the benchmark, but every frame goes to a file stamped with its
+// simulation time (tick / fps), so an hour of animation takes seconds to produce.
+struct ExportJob {
+  string path;
+  ExportFormat fmt=EXPORT_CAST;
+  double secs=60;              // length when not replaying
 };
 
-static inline bool would_exit(const State& s, Direction nd){
-  int nx=s.x, ny=s.y;
-  if (nd==UP) --ny; else if (nd==DOWN) ++ny; else if (nd==LEFT) --nx; else ++nx;
-  return nx<0 || nx>=term.W || ny<0 || ny>=term.H;
-}
+static int run_export(const Bench& b, const ExportJob& job){
+  term.W=b.W; term.H=b.H;
+  Out& out=term.out;
+  out.sink=SINK_MEM;   // each frame is taken from mem and cleared, so it never grows past one frame
+  term.lfcr=false;     // a recorded stream has no ONLCR: LF only moves down
+  Exporter ex;
+  if (!ex.open(job.path.c_str(), job.fmt, b.W, b.H, cfg.seed)){ cerr << "Error: cannot write " << job.path << ".\n"; return 1; }
 
-// Step: decide -> draw -> move 
-static long long drawn=0;
-static void draw_step(State& s, const PipeType&){
-  s.out = s.in;
-  if (rnd(20) >= cfg.straight) s.out = (rnd(2)? turn_left(s.in): turn_right(s.in));
-  if (would_exit(s, s.out)){
-    if (!cfg.keepOnEdge){
-      s.colorIndex = palette[rnd((int)palette.size())];
-      s.typeIndex  = rnd((int)activeTypes.size());
-    }
-    Direction L=turn_left(s.in), R=turn_right(s.in);
-    bool okL=!would_exit(s,L), okR=!would_exit(s,R);
-    if (okL && okR) s.out = (rnd(2)? L:R);
-    else if (okL)   s.out = L;
-    else if (okR)   s.out = R;
-    else            s.out = s.in;
+  Pipes S = spawn_pipes();
+  pending.W=b.W; pending.H=b.H;
+  long long last_reset=0, f=0;
+  const long long frames = b.replay ? 0 : max(1LL, llround(job.secs*cfg.fps));
+  double t=0;
+  int w=b.W, h=b.H;
+  const auto t0=chrono::steady_clock::now();
+  term.hideCursor(); term.clear();
+  for (; b.replay || f<frames; f++){
+    if (b.replay && !replay_due(*b.replay, f, S)) break;
+    if (term.W!=w || term.H!=h){ w=term.W; h=term.H; ex.resize(t, w, h); }
+    step_all(S, last_reset);
+    term.syncBegin();
+    apply_frame(pending); pending.reset();
+    screen.flush();
+    term.syncEnd();
+    out.commit();
+    ex.frame(t, out.mem.data(), out.mem.size()); out.mem.clear();
+    t += 1.0/cfg.fps;
   }
-  int idx = idx_from(s.in, s.out);
-  const string& g = T[ activeTypes[s.typeIndex] ].g[idx-1];
-  term.mv(s.x, s.y);
-  cout << ansi_color(s.colorIndex) << g << ansi_reset();
-  s.in = s.out;
-  if (s.in==UP) --s.y; else if (s.in==DOWN) ++s.y; else if (s.in==LEFT) --s.x; else ++s.x;
-  ++drawn;
-}
-
-// Hotkeys during run 
-static void handle_keys_once(){
-  if (!term.kbhit()) return;
-  int ch = term.getch_now();
-  if (ch==-1) return;
-  if      (ch=='P') cfg.straight = min(15, cfg.straight+1);
-  else if (ch=='O') cfg.straight = max(5,  cfg.straight-1);
-  else if (ch=='F') cfg.fps      = min(100,cfg.fps+5);
-  else if (ch=='D') cfg.fps      = max(20, cfg.fps-5);
-  else if (ch=='B') cfg.noBold   = !cfg.noBold;
-  else if (ch=='C') cfg.noColor  = !cfg.noColor;
-  else if (ch=='K') cfg.keepOnEdge = !cfg.keepOnEdge;
-  else throw runtime_error("quit");
+  if (!ex.close()){ cerr << "Error: writing " << job.path << " failed.\n"; return 1; }
+  const double wall=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+  char line[200];
+  snprintf(line, sizeof line, "Exported %lld frames (%.1f s of animation) in %.2f s: %lld bytes in %lld writes to %s\n",
+           f, t, wall, ex.bytes, ex.writes, job.path.c_str());
+  cout << line;
+  return 0;
 }
 
 // Menu: set params without CLI 
 static void draw_menu(){
+  term.resetAttrs();
   term.clear();
+  term.cx=term.cy=-1;
   cout << "\n  PIPES — pre-run menu (press Enter to start)\n\n";
   cout << "  A/Z  Pipes:            " << cfg.p << "\n";
   cout << "  S/X  Straight [5..15]: " << cfg.straight << "\n";
-  cout << "  F/D  FPS [20..100]:    " << cfg.fps << "\n";
+  cout << "  F/D  FPS [20.." << cfg.maxFps << "]:" << string(cfg.maxFps<100? 5: 4, ' ') << cfg.fps << "\n";
   cout << "  L/J  Limit chars:      " << (cfg.limit==0? string("infinite") : to_string(cfg.limit)) << "\n";
   cout << "  R    Random start:     " << (cfg.randomStart? "ON":"OFF") << "\n";
   cout << "  K    Keep on edge:     " << (cfg.keepOnEdge? "ON":"OFF") << "\n";
@@ -256,30 +297,32 @@ static bool run_menu(){
   palette     = {1,2,3,4,5,6,7,0};
   draw_menu();
   while (true){
-    if (term.checkResize()) draw_menu();
-    int ch = term.getch_now();
-    if (ch == -1){ sleep_ms(10); continue; }
-    if (ch=='\r' || ch=='\n') return true;
-    if (ch==27 || ch=='q' || ch=='Q') return false;
-    if (ch=='A' || ch=='a') cfg.p = max(1, cfg.p+1);
-    else if (ch=='Z' || ch=='z') cfg.p = max(1, cfg.p-1);
-    else if (ch=='S' || ch=='s') cfg.straight = min(15, cfg.straight+1);
-    else if (ch=='X' || ch=='x') cfg.straight = max(5,  cfg.straight-1);
-    else if (ch=='F' || ch=='f') cfg.fps = min(100, cfg.fps+5);
-    else if (ch=='D' || ch=='d') cfg.fps = max(20,  cfg.fps-5);
-    else if (ch=='R' || ch=='r') cfg.randomStart = !cfg.randomStart;
-    else if (ch=='K' || ch=='k') cfg.keepOnEdge  = !cfg.keepOnEdge;
-    else if (ch=='C' || ch=='c') cfg.noColor     = !cfg.noColor;
-    else if (ch=='V' || ch=='v') cfg.vivid       = !cfg.vivid;
-    else if (ch=='T' || ch=='t'){ int v=activeTypes.front(); v=(v+1)%10; activeTypes[0]=v; }
-    else if (ch=='L' || ch=='l'){
-      if (cfg.limit==0) cfg.limit=1000; else cfg.limit = min<long long>(cfg.limit*10, 1000000000LL);
-    } else if (ch=='J' || ch=='j'){
-      if (cfg.limit==0) cfg.limit=1000;
-      cfg.limit = max<long long>( (cfg.limit/10), 0LL );
-      if (cfg.limit<10) cfg.limit=0;
+    // Sleeps until a key or a resize; nothing runs while the menu is idle.
+    events.wait(Events::clock::time_point::max());
+    bool redraw = term.checkResize();
+    for (int ch; (ch=events.key())!=-1; redraw=true){
+      if (ch=='\r' || ch=='\n') return true;
+      if (ch==27 || ch=='q' || ch=='Q') return false;
+      if (ch=='A' || ch=='a') cfg.p = max(1, cfg.p+1);
+      else if (ch=='Z' || ch=='z') cfg.p = max(1, cfg.p-1);
+      else if (ch=='S' || ch=='s') cfg.straight = min(15, cfg.straight+1);
+      else if (ch=='X' || ch=='x') cfg.straight = max(5,  cfg.straight-1);
+      else if (ch=='F' || ch=='f') cfg.fps = min(cfg.maxFps, cfg.fps+5);
+      else if (ch=='D' || ch=='d') cfg.fps = max(20,  cfg.fps-5);
+      else if (ch=='R' || ch=='r') cfg.randomStart = !cfg.randomStart;
+      else if (ch=='K' || ch=='k') cfg.keepOnEdge  = !cfg.keepOnEdge;
+      else if (ch=='C' || ch=='c') cfg.noColor     = !cfg.noColor;
+      else if (ch=='V' || ch=='v') cfg.vivid       = !cfg.vivid;
+      else if (ch=='T' || ch=='t'){ int v=activeTypes.front(); v=(v+1)%10; activeTypes[0]=v; }
+      else if (ch=='L' || ch=='l'){
+        if (cfg.limit==0) cfg.limit=1000; else cfg.limit = min<long long>(cfg.limit*10, 1000000000LL);
+      } else if (ch=='J' || ch=='j'){
+        if (cfg.limit==0) cfg.limit=1000;
+        cfg.limit = max<long long>( (cfg.limit/10), 0LL );
+        if (cfg.limit<10) cfg.limit=0;
+      }
     }
-    draw_menu();
+    if (redraw) draw_menu();
   }
 }
 
@@ -287,14 +330,25 @@ static bool run_menu(){
 static void print_help(const char* prog){
   cout <<
 "Usage: " << prog << " [no-args shows interactive menu]\n"
-"-p N  -t SET ... -c COL ... -f FPS -s STR -r LIMIT -R -B -C -K -h -v\n";
+"-p N  -t SET ... -c COL ... -f FPS -s STR -r LIMIT -R -B -C -K -h -v\n"
+"--seed N  --no-simd  --threads N (0=all cores)  --max-fps N  --pacing skip|catchup\n"
+"--limit-mode erase|clear|cover  (past -r LIMIT: fade the oldest cells, or clear the screen;\n"
+"                                 cover: clear once --cover PCT of the screen is drawn, default 90)\n"
+"--avoid  (pipes turn into free cells when they can)\n"
+"--caps auto|none|sync,rep,ech  (terminal features; auto asks the terminal)\n"
+"--bench FRAMES | --bench-steps STEPS  [--sink null|mem|devnull|pty] [--size WxH]\n"
+"--export FILE [--format cast|ttyrec] [--duration SECS] [--size WxH] [--replay FILE]\n"
+"--serve SOCKET [--size WxH]  |  --view SOCKET  (one simulation, many local viewers)\n"
+"--publish NAME  (live canvas in POSIX shared memory /NAME; read it with pipes_peek)\n"
+"--metrics FILE  (append a JSON line of frame timings every second; I toggles the stats line)\n"
+"--record FILE  |  --replay FILE [--speed N|max] [--sink ...]  (headless with --sink)\n";
 }
 
 // main 
 int main(int argc, char** argv){
   ios::sync_with_stdio(false);
   cin.tie(nullptr);
-  srand((unsigned)time(nullptr));
+  bool seeded = false;
 
   init_types();
   activeTypes = {0};
@@ -302,6 +356,15 @@ int main(int argc, char** argv){
 
   // If any CLI flag was provided, skip menu and use CLI behavior.
   bool use_menu = (argc==1);
+  bool bench = false;
+  Bench b;
+  string caps = "auto";
+  string recordPath, replayPath, metricsPath;
+  double speed = 1;              // replay pace over the recorded fps; 0 = as fast as possible
+  bool sinkSet = false;
+  ExportJob job;
+  string servePath, viewPath, publishName;
+  bool sizeSet = false;
 
   for (int i=1;i<argc;i++){
     string a = argv[i];
@@ -315,8 +378,8 @@ int main(int argc, char** argv){
         while ((int)chars.size()<16 && i+1<argc && argv[i+1][0]!='-') chars += argv[++i];
         if ((int)chars.size()<16){ cerr << "Error: -t c requires 16 chars.\n"; return 1; }
         PipeType custom{};
-        for (int k=0;k<16;k++){ string s; s+=chars[k]; custom.g[k]=s; }
-        custom.g[2]=" "; custom.g[7]=" "; custom.g[8]=" "; custom.g[13]=" ";
+        for (int k=0;k<16;k++){ custom.g[k].b[0]=chars[k]; custom.g[k].n=1; }
+        custom.g[2]=custom.g[7]=custom.g[8]=custom.g[13]=glyph(" ");
         T[0]=custom; activeTypes={0};
       } else {
         int tid = max(0, min(9, atoi(v.c_str())));
@@ -324,20 +387,107 @@ int main(int argc, char** argv){
       }
     }
     else if (a=="-c" && i+1<argc){ int col=(atoi(argv[++i])%8+8)%8; palette.push_back(col); use_menu=false; }
-    else if (a=="-f" && i+1<argc){ cfg.fps = max(20, min(100, atoi(argv[++i]))); use_menu=false; }
+    else if (a=="-f" && i+1<argc){ cfg.fps = max(20, atoi(argv[++i])); use_menu=false; }
     else if (a=="-s" && i+1<argc){ cfg.straight = max(5, min(15, atoi(argv[++i]))); use_menu=false; }
     else if (a=="-r"){ if (i+1<argc && argv[i+1][0]!='-') cfg.limit=atoll(argv[++i]); else cfg.limit=0; use_menu=false; }
     else if (a=="-R"){ cfg.randomStart=true; use_menu=false; }
     else if (a=="-B"){ cfg.noBold=true; use_menu=false; }
     else if (a=="-C"){ cfg.noColor=true; use_menu=false; }
     else if (a=="-K"){ cfg.keepOnEdge=true; use_menu=false; }
+    else if (a=="--bench" && i+1<argc){ b.frames = max(1LL, atoll(argv[++i])); bench=true; }
+    else if (a=="--bench-steps" && i+1<argc){ b.steps = max(1LL, atoll(argv[++i])); bench=true; }
+    else if (a=="--sink" && i+1<argc){ b.sink = argv[++i]; sinkSet=true; }
+    else if (a=="--size" && i+1<argc){
+      if (sscanf(argv[++i], "%dx%d", &b.W, &b.H)!=2 || b.W<1 || b.H<1 || b.W>65535 || b.H>65535){
+        cerr << "Error: --size expects WxH.\n"; return 1;
+      }
+      sizeSet=true;
+    }
+    else if (a=="--no-simd"){ cfg.simd=false; }
+    else if (a=="--threads" && i+1<argc){
+      int n = atoi(argv[++i]);
+      cfg.threads = n>0 ? n : max(1, (int)thread::hardware_concurrency());
+    }
+    else if (a=="--caps" && i+1<argc){ caps = argv[++i]; }
+    else if (a=="--limit-mode" && i+1<argc){
+      string v = argv[++i];
+      if (v=="erase") cfg.limitMode=LIMIT_ERASE; else if (v=="clear") cfg.limitMode=LIMIT_CLEAR;
+      else if (v=="cover") cfg.limitMode=LIMIT_COVER;
+      else { cerr << "Error: --limit-mode expects erase, clear or cover.\n"; return 1; }
+    }
+    else if (a=="--serve" && i+1<argc){ servePath = argv[++i]; }
+    else if (a=="--view" && i+1<argc){ viewPath = argv[++i]; }
+    else if (a=="--publish" && i+1<argc){ publishName = argv[++i]; }
+    else if (a=="--metrics" && i+1<argc){ metricsPath = argv[++i]; }
+    else if (a=="--export" && i+1<argc){ job.path = argv[++i]; }
+    else if (a=="--format" && i+1<argc){
+      string v = argv[++i];
+      if (v=="cast") job.fmt=EXPORT_CAST; else if (v=="ttyrec") job.fmt=EXPORT_TTYREC;
+      else { cerr << "Error: --format expects cast or ttyrec.\n"; return 1; }
+    }
+    else if (a=="--duration" && i+1<argc){
+      job.secs = atof(argv[++i]);
+      if (!(job.secs>0)){ cerr << "Error: --duration expects seconds.\n"; return 1; }
+    }
+    else if (a=="--record" && i+1<argc){ recordPath = argv[++i]; }
+    else if (a=="--replay" && i+1<argc){ replayPath = argv[++i]; use_menu=false; }
+    else if (a=="--speed" && i+1<argc){
+      string v = argv[++i];
+      speed = v=="max" ? 0 : atof(v.c_str());
+      if (v!="max" && !(speed>0)){ cerr << "Error: --speed expects a positive factor or max.\n"; return 1; }
+    }
+    else if (a=="--cover" && i+1<argc){ cfg.coverPct = max(1, min(100, atoi(argv[++i]))); cfg.limitMode=LIMIT_COVER; }
+    else if (a=="--avoid"){ cfg.avoid=true; }
+    else if (a=="--seed" && i+1<argc){ cfg.seed = strtoull(argv[++i], nullptr, 0); seeded=true; }
+    else if (a=="--max-fps" && i+1<argc){ cfg.maxFps = max(20, atoi(argv[++i])); }
+    else if (a=="--pacing" && i+1<argc){
+      string v = argv[++i];
+      if (v=="catchup") cfg.catchUp=true; else if (v=="skip") cfg.catchUp=false;
+      else { cerr << "Error: --pacing expects skip or catchup.\n"; return 1; }
+    }
     else { cerr << "Unknown option: " << a << "\n"; return 1; }
   }
+  // A replay takes its seed, config and canvas from the recording.
+  ReplayCursor replay;
+  if (!replayPath.empty()){
+    string err;
+    if (!replay.log.open(replayPath.c_str(), err)){ cerr << "Error: " << replayPath << ": " << err << ".\n"; return 1; }
+    replay.log.apply_config();
+    replay.have = replay.log.next(replay.ev);
+    b.W=term.W; b.H=term.H; seeded=true;
+    cfg.maxFps = max(cfg.maxFps, cfg.fps);
+  }
+  cfg.fps = min(cfg.fps, cfg.maxFps);
+  if (!seeded) cfg.seed = (uint64_t)chrono::steady_clock::now().time_since_epoch().count() ^ (uint64_t)time(nullptr);
+  if (palette.empty()) palette = {1,2,3,4,5,6,7,0};
+  if (activeTypes.empty()) activeTypes={0};
+  // --caps auto probes the terminal; otherwise a list (sync,rep,ech) or none.
+  if (caps!="auto"){
+    for (size_t s=0; s<=caps.size();){
+      size_t e=caps.find(',', s); if (e==string::npos) e=caps.size();
+      const string c=caps.substr(s, e-s);
+      if (c=="sync") term.caps.sync=true; else if (c=="rep") term.caps.rep=true; else if (c=="ech") term.caps.ech=true;
+      else if (c!="none"){ cerr << "Error: --caps expects auto, none or a list of sync,rep,ech.\n"; return 1; }
+      s=e+1;
+    }
+  }
+  if (!viewPath.empty()) return run_view(viewPath.c_str());
+  if (!servePath.empty()){
+    ServeOptions so; so.W=b.W; so.H=b.H; so.grow=!sizeSet;
+    return run_serve(servePath.c_str(), so);
+  }
+  if (!job.path.empty()){ if (!replayPath.empty()) b.replay=&replay; return run_export(b, job); }
+  if (!replayPath.empty() && sinkSet){ b.replay=&replay; return run_bench(b); }
+  if (bench) return run_bench(b);
 
+  events.init();   // before any thread, so SIGWINCH reaches only the signalfd
+  const Term::Caps forced = term.caps;
   Term t; term = t; term.init();
+  if (caps=="auto") term.probe(200); else term.caps=forced;
+  if (!replayPath.empty()){ term.W=replay.log.hdr.W; term.H=replay.log.hdr.H; }
   if (use_menu){
     if (!run_menu()){
-      term.restore(); term.clear(); return 0;
+      term.restore(); term.clear(); events.close(); return 0;
     }
   }
   term.clear();
@@ -345,39 +495,105 @@ int main(int argc, char** argv){
   if (palette.empty()) palette = {1,2,3,4,5,6,7,0};
   if (activeTypes.empty()) activeTypes={0};
 
-  vector<State> S(cfg.p);
-  for (auto& s: S){
-    s.colorIndex = palette[rnd((int)palette.size())];
-    s.typeIndex  = rnd((int)activeTypes.size());
-    s.in = (Direction)rnd(4);
-    if (cfg.randomStart){ s.x=rnd(term.W); s.y=rnd(term.H); }
-    else { s.x=term.W/2; s.y=term.H/2; }
+  if (!recordPath.empty() && !rec.open(recordPath.c_str())){
+    term.restore(); term.clear(); events.close();
+    cerr << "Error: cannot write " << recordPath << ".\n"; return 1;
+  }
+  if (!metricsPath.empty() && !metrics.open(metricsPath.c_str())){
+    term.restore(); term.clear(); events.close();
+    cerr << "Error: cannot write " << metricsPath << ".\n"; return 1;
+  }
+
+  Pipes S = spawn_pipes();
+  if (!publishName.empty()){
+    string err;
+#ifndef _WIN32
+    if (!pub.open(publishName.c_str(), term.W, term.H, S.size(), err))
+#else
+    err="needs POSIX shared memory";
+#endif
+    {
+      term.restore(); term.clear(); events.close();
+      cerr << "Error: cannot publish " << publishName << ": " << err << ".\n"; return 1;
+    }
   }
 
   long long last_reset = 0;
+  pending.W=term.W; pending.H=term.H;
+  atomic<bool> stop{false};
+  term.out.setAsync(true);
+  renderer.metrics=&metrics;
+  renderer.open();                 // without a wake channel the render thread polls instead
+  thread render([&]{ renderer.run(stop); });
+  Scheduler sched; sched.catchUp=cfg.catchUp;
+  auto pace=[&]{ return max(1, (int)(cfg.fps*(speed>0 ? speed : 1))); };
+  sched.start(pace());
+  // One metrics window per period; the last, partial one closes on the way out.
+  auto rolled=chrono::steady_clock::now();
+  auto roll=[&](bool last){
+    const auto now=chrono::steady_clock::now();
+    if (!last && now-rolled<METRICS_PERIOD) return;
+    metrics.roll(chrono::duration<double>(now-rolled).count(), pace(), S.size(), RunCounters{sched.late, sched.skipped});
+    rolled=now;
+    if (!last) renderer.wake();   // a new stats line
+  };
   try{
+    // Replay: the recorded size and events at the recorded fps times --speed; any key stops it.
+    while (!replayPath.empty()){
+      const unsigned ev = events.wait(speed>0 ? sched.next : Events::clock::now());
+      if (ev & Events::EV_KEY) throw runtime_error("quit");
+      const int ticks = speed==0 ? 1 : (ev & Events::EV_TICK) ? sched.wait() : 0;
+      for (int k=0;k<ticks;k++){
+        if (!replay_due(replay, tick, S)) throw runtime_error("end");
+        sim_tick(S, last_reset);
+      }
+      sched.setFps(pace());
+      roll(false);
+    }
+    bool resizing=false;
+    Events::clock::time_point settle{};
     while (true){
-      if (term.checkResize()){
-        for (auto& s: S){
-          s.x = min(max(0,s.x), term.W-1);
-          s.y = min(max(0,s.y), term.H-1);
-        }
+      // Wake on the frame deadline (or the resize settling) or on input, whichever comes first.
+      const unsigned ev = events.wait(resizing ? settle : sched.next);
+      if (term.checkResize()){ resizing=true; settle=Events::clock::now()+RESIZE_SETTLE; }
+      if (resizing){
+        // Simulation and output pause until the size settles.
+        if (Events::clock::now()>=settle){ resizing=false; apply_resize(S); sched.rebase(); }
       }
-      for (auto& s: S){
-        draw_step(s, T[ activeTypes[s.typeIndex] ]);
-        if (cfg.limit>0 && (drawn - last_reset) >= cfg.limit){
-          term.clear(); last_reset = drawn;
-        }
+      else if (ev & Events::EV_TICK){
+        const int ticks = sched.wait();
+        for (int k=0;k<ticks;k++) sim_tick(S, last_reset);
       }
-      handle_keys_once();
-      int ms = max(1, 1000 / cfg.fps);
-      cout << flush;
-      sleep_ms(ms);
+      handle_keys();
+      sched.setFps(cfg.fps);
+      roll(false);
     }
   } catch (const runtime_error&){}
+  // The last delta waits for a ring slot only as long as a slow terminal gets to catch up.
+  for (auto until=chrono::steady_clock::now()+QUIT_GRACE; !ring.push(pending) && chrono::steady_clock::now()<until;)
+    this_thread::yield();
+  stop.store(true, memory_order_release);
+  renderer.wake();
+  render.join();
+  rec.end(tick);
+  if (metrics.log) roll(true);
+  metrics.close();
+#ifndef _WIN32
+  pub.close();
+#endif
+  term.out.setAsync(false);
 
+  events.close();
   term.restore();
   term.clear();
-  cout << "Drawn: " << drawn << "\n";
+  cout << "Drawn: " << drawn << "  Seed: " << cfg.seed << "\n";
+  char line[160];
+  snprintf(line, sizeof line, "Frames: %lld  target %.3f ms  measured %.3f ms  late %lld  skipped %lld  worst %.3f ms\n",
+           sched.frames, sched.target_ms(), sched.measured_ms(), sched.late, sched.skipped,
+           chrono::duration<double,milli>(sched.worst).count());
+  cout << line;
+  snprintf(line, sizeof line, "Output: %lld flushes  %lld frames coalesced  backlog peak %zu B  drain %.0f B/s\n",
+           renderer.flushes, renderer.coalesced, term.out.peak, term.out.drainRate);
+  cout << line;
   return 0;
 }
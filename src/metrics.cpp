@@ -0,0 +1,97 @@
+// metrics.cpp — timing histograms, overlay line and JSON-lines log
+
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <ctime>
+
+using namespace std;
+
+static int bucket(uint64_t v){
+  if (v<8) return (int)v;
+  int e=3;
+  while (v>>(e+1)) ++e;
+  return min(Histogram::BUCKETS-1, (e-2)*8 + (int)((v>>(e-3)) & 7));
+}
+static uint64_t bucket_mid(int i){
+  if (i<8) return (uint64_t)i;
+  const int e=i/8+2;
+  return ((uint64_t)(8+i%8) << (e-3)) + ((uint64_t)1 << (e-3))/2;
+}
+
+void Histogram::add(uint64_t ns){
+  ++n[bucket(ns)]; ++count; sum+=ns;
+  peak=max(peak, ns);
+}
+
+uint64_t Histogram::quantile(double q) const {
+  if (!count) return 0;
+  const uint64_t rank=max<uint64_t>(1, (uint64_t)(q*(double)count + 0.5));
+  uint64_t seen=0;
+  for (int i=0;i<BUCKETS;i++) if ((seen+=n[i])>=rank) return min(bucket_mid(i), peak);
+  return peak;
+}
+
+bool Metrics::open(const char* path){
+  log=fopen(path, "a");
+  return log!=nullptr;
+}
+
+void Metrics::close(){
+  if (log){ fclose(log); log=nullptr; }
+}
+
+void Metrics::tick(uint64_t simNs){
+  lock_guard<mutex> lk(m);
+  sim.add(simNs); ++ticks;
+}
+
+void Metrics::frame(uint64_t encodeNs, uint64_t writeNs, long long frameBytes, int merged, size_t pending){
+  lock_guard<mutex> lk(m);
+  encode.add(encodeNs); write.add(writeNs);
+  ++frames; coalesced+=merged; bytes+=frameBytes;
+  backlog=max(backlog, pending);
+}
+
+void Metrics::roll(double secs, int targetFps, size_t pipes, const RunCounters& now){
+  // The log line is only formatted under the lock; the render thread must not wait on the file.
+  char rec[1024];
+  int n=0;
+  {
+    lock_guard<mutex> lk(m);
+    const double fps=secs>0 ? (double)frames/secs : 0;
+    const double bpf=frames ? (double)bytes/(double)frames : 0;
+    const long long late=now.late-seen.late, skipped=now.skipped-seen.skipped;
+    auto us=[](const Histogram& h){ return (double)h.quantile(0.5)/1e3; };
+    char b[256];
+    snprintf(b, sizeof b, " %.0f/%dfps sim %.0fus enc %.0fus wr %.0fus %.0fB/f %zu pipes late %lld skip %lld merged %lld ",
+             fps, targetFps, us(sim), us(encode), us(write), bpf, pipes, late, skipped, coalesced);
+    if (line!=b){ line=b; ++version; }
+
+    if (log){
+      auto q=[](const Histogram& h, char* p, size_t n){
+        snprintf(p, n, "{\"p50\":%.1f,\"p95\":%.1f,\"p99\":%.1f,\"max\":%.1f,\"mean\":%.1f}",
+                 h.quantile(0.50)/1e3, h.quantile(0.95)/1e3, h.quantile(0.99)/1e3, h.peak/1e3, h.mean()/1e3);
+      };
+      char hs[3][160];
+      q(sim, hs[0], sizeof hs[0]); q(encode, hs[1], sizeof hs[1]); q(write, hs[2], sizeof hs[2]);
+      n=snprintf(rec, sizeof rec, "{\"time\":%lld,\"secs\":%.3f,\"fps\":%.2f,\"target_fps\":%d,\"ticks\":%lld,\"frames\":%lld,"
+                   "\"bytes_per_frame\":%.1f,\"pipes\":%zu,\"late\":%lld,\"skipped\":%lld,\"coalesced\":%lld,\"backlog\":%zu,"
+                   "\"sim_us\":%s,\"encode_us\":%s,\"write_us\":%s}\n",
+              (long long)time(nullptr), secs, fps, targetFps, ticks, frames, bpf, pipes, late, skipped, coalesced, backlog,
+              hs[0], hs[1], hs[2]);
+    }
+
+    sim.reset(); encode.reset(); write.reset();
+    ticks=frames=coalesced=bytes=0; backlog=0;
+    seen=now;
+  }
+  if (n>0){ fwrite(rec, 1, min((size_t)n, sizeof rec-1), log); fflush(log); }
+}
+
+bool Metrics::overlay(unsigned& have, string& out){
+  lock_guard<mutex> lk(m);
+  if (have==version) return false;
+  out=line; have=version;
+  return true;
+}
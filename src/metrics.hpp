@@ -0,0 +1,49 @@
+// metrics.hpp — run statistics: timing histograms, the stats overlay line and the --metrics log
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// Latency histogram over nanoseconds, log-linear: 8 buckets per octave (12.5% steps).
+// Fixed size, so adding a sample never allocates.
+struct Histogram {
+  static constexpr int BUCKETS = 8*40;
+  uint32_t n[BUCKETS]{};
+  uint64_t count=0, sum=0, peak=0;
+  void add(uint64_t ns);
+  // Value at quantile q in [0,1], as the midpoint of its bucket (capped at the peak).
+  uint64_t quantile(double q) const;
+  double mean() const { return count ? (double)sum/(double)count : 0; }
+  void reset(){ *this=Histogram(); }
+};
+
+// Scheduler-side counters, cumulative over the run.
+struct RunCounters { long long late=0, skipped=0; };
+
+// Statistics of one reporting window. The simulation thread adds ticks, the render thread
+// frames; roll() closes the window, formats the overlay line (medians) from it and, with a log open,
+// appends it as one JSON object per line.
+struct Metrics {
+  std::mutex m;
+  Histogram sim, encode, write;
+  long long ticks=0, frames=0, coalesced=0, bytes=0;
+  size_t backlog=0;                  // peak bytes the terminal had not taken
+  RunCounters seen;                  // counters at the last roll
+  std::string line;                  // overlay text for the last closed window
+  unsigned version=0;                // bumps whenever line changes
+  FILE* log=nullptr;
+
+  Metrics(){ line.reserve(256); }    // roll() formats into 256 bytes, so a new line never reallocates
+  bool open(const char* path);       // appends; false if it cannot be opened
+  void close();
+  ~Metrics(){ close(); }
+  void tick(uint64_t simNs);
+  void frame(uint64_t encodeNs, uint64_t writeNs, long long frameBytes, int merged, size_t pending);
+  void roll(double secs, int targetFps, size_t pipes, const RunCounters& now);
+  // Copy the overlay line if it changed since 'have'; returns whether it did.
+  bool overlay(unsigned& have, std::string& out);
+};
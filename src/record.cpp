@@ -0,0 +1,142 @@
+// record.cpp — run recording and replay
+
+#include "record.hpp"
+#include "term.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+using namespace std;
+
+static void put_varint(FILE* f, unsigned long long v){
+  unsigned char b[10]; int n=0;
+  do { b[n]=(unsigned char)(v&0x7f); v>>=7; if (v) b[n]|=0x80; ++n; } while (v);
+  fwrite(b, 1, (size_t)n, f);
+}
+
+bool Recorder::open(const char* path){
+  f=fopen(path, "wb");
+  if (!f) return false;
+  RecHeader h{};
+  memcpy(h.magic, "PIPESREC", 8);
+  h.version=REC_VERSION; h.size=sizeof(RecHeader);
+  h.seed=cfg.seed;
+  h.W=term.W; h.H=term.H; h.p=cfg.p; h.fps=cfg.fps; h.straight=cfg.straight;
+  h.limit=cfg.limit; h.limitMode=(uint8_t)cfg.limitMode;
+  h.randomStart=cfg.randomStart; h.noBold=cfg.noBold; h.noColor=cfg.noColor;
+  h.keepOnEdge=cfg.keepOnEdge; h.vivid=cfg.vivid;
+  h.coverPct=(uint8_t)cfg.coverPct; h.avoid=cfg.avoid;
+  h.nTypes=(uint8_t)min<size_t>(activeTypes.size(), 10);
+  for (int i=0;i<h.nTypes;i++) h.types[i]=(int8_t)activeTypes[i];
+  h.nPalette=(uint8_t)min<size_t>(palette.size(), 16);
+  for (int i=0;i<h.nPalette;i++) h.palette[i]=(int8_t)palette[i];
+  h.custom = memcmp(&T[0], &BUILTIN_TYPES[0], sizeof(PipeType))!=0;
+  h.type0=T[0];
+  fwrite(&h, sizeof h, 1, f);
+  fflush(f);
+  t0=clock::now(); lastTick=lastUs=0;
+  return true;
+}
+
+void Recorder::event(long long tick, RecKind kind){
+  const long long us=chrono::duration_cast<chrono::microseconds>(clock::now()-t0).count();
+  put_varint(f, (unsigned long long)(tick-lastTick));
+  put_varint(f, (unsigned long long)max(0LL, us-lastUs));
+  fputc(kind, f);
+  lastTick=tick; lastUs=max(us, lastUs);
+}
+
+void Recorder::key(long long tick, int ch){
+  if (!f) return;
+  event(tick, REC_KEY); fputc(ch, f); fflush(f);
+}
+
+void Recorder::resize(long long tick, int W, int H){
+  if (!f) return;
+  event(tick, REC_RESIZE); put_varint(f, (unsigned)W); put_varint(f, (unsigned)H); fflush(f);
+}
+
+void Recorder::end(long long tick){
+  if (!f) return;
+  event(tick, REC_END);
+  fclose(f); f=nullptr;
+}
+
+Replay::~Replay(){
+#ifndef _WIN32
+  if (mapped) munmap((void*)data, size);
+#endif
+}
+
+bool Replay::open(const char* path, string& err){
+#ifndef _WIN32
+  const int fd=::open(path, O_RDONLY);
+  struct stat st{};
+  if (fd<0 || fstat(fd, &st)!=0){ err="cannot open"; if (fd>=0) ::close(fd); return false; }
+  size=(size_t)st.st_size;
+  if (size){
+    void* m=mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m!=MAP_FAILED){ data=(const unsigned char*)m; mapped=true; madvise(m, size, MADV_SEQUENTIAL); }
+  }
+  ::close(fd);
+  if (!mapped){ err="cannot map"; return false; }
+#else
+  FILE* f=fopen(path, "rb");
+  if (!f){ err="cannot open"; return false; }
+  char chunk[1<<16]; size_t n;
+  while ((n=fread(chunk,1,sizeof chunk,f))>0) buf.append(chunk, n);
+  fclose(f);
+  data=(const unsigned char*)buf.data(); size=buf.size();
+#endif
+  if (size<sizeof hdr){ err="truncated recording"; return false; }
+  memcpy(&hdr, data, sizeof hdr);
+  if (memcmp(hdr.magic, "PIPESREC", 8)!=0){ err="not a pipes recording"; return false; }
+  if (hdr.version!=REC_VERSION || hdr.size!=sizeof hdr){ err="unsupported recording version"; return false; }
+  if (hdr.nTypes<1 || hdr.nTypes>10 || hdr.nPalette<1 || hdr.nPalette>16){ err="corrupt recording header"; return false; }
+  pos=sizeof hdr; tick=us=0;
+  return true;
+}
+
+void Replay::apply_config() const {
+  cfg.seed=hdr.seed;
+  cfg.p=hdr.p; cfg.fps=hdr.fps; cfg.straight=hdr.straight;
+  cfg.limit=hdr.limit; cfg.limitMode=(LimitMode)hdr.limitMode;
+  cfg.randomStart=hdr.randomStart; cfg.noBold=hdr.noBold; cfg.noColor=hdr.noColor;
+  cfg.keepOnEdge=hdr.keepOnEdge; cfg.vivid=hdr.vivid;
+  cfg.coverPct=hdr.coverPct; cfg.avoid=hdr.avoid;
+  activeTypes.assign(hdr.types, hdr.types+hdr.nTypes);
+  palette.assign(hdr.palette, hdr.palette+hdr.nPalette);
+  if (hdr.custom) T[0]=hdr.type0;
+  term.W=hdr.W; term.H=hdr.H;
+}
+
+bool Replay::next(RecEvent& e){
+  auto varint=[&](unsigned long long& v){
+    v=0;
+    for (int s=0; pos<size && s<64; s+=7){
+      const unsigned char b=data[pos++];
+      v|=(unsigned long long)(b&0x7f)<<s;
+      if (!(b&0x80)) return true;
+    }
+    return false;
+  };
+  unsigned long long dt, dus;
+  if (pos>=size || !varint(dt) || !varint(dus) || pos>=size) return false;
+  tick+=(long long)dt; us+=(long long)dus;
+  e=RecEvent{}; e.tick=tick; e.us=us; e.kind=(RecKind)data[pos++];
+  if (e.kind==REC_KEY){ if (pos>=size) return false; e.key=data[pos++]; }
+  else if (e.kind==REC_RESIZE){
+    unsigned long long w, h;
+    if (!varint(w) || !varint(h)) return false;
+    e.W=(int)w; e.H=(int)h;
+  }
+  else if (e.kind!=REC_END) return false;
+  return true;
+}
@@ -0,0 +1,70 @@
+// record.hpp — run recording: compact binary event log and mmap'd replay
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "core.hpp"
+
+// A run is reproducible from its seed, config and canvas plus the keys and
+// resizes it saw, each pinned to the simulation tick it preceded.
+// Layout: RecHeader, then events of varint(tick delta) varint(us delta) u8 kind [payload].
+struct RecHeader {
+  char magic[8];               // "PIPESREC"
+  uint32_t version, size;      // REC_VERSION, sizeof(RecHeader)
+  uint64_t seed;
+  int32_t W, H, p, fps, straight;
+  int64_t limit;
+  uint8_t limitMode, randomStart, noBold, noColor, keepOnEdge, vivid;
+  uint8_t nTypes, nPalette;
+  int8_t types[10], palette[16];
+  uint8_t custom;              // T[0] was replaced by -t c; type0 holds it
+  uint8_t coverPct, avoid;
+  PipeType type0;
+};
+constexpr uint32_t REC_VERSION = 3;     // 3: per-pipe streams seeded from a hash of the stream index
+
+enum RecKind : uint8_t { REC_KEY=1, REC_RESIZE=2, REC_END=3 };
+struct RecEvent {
+  long long tick=0, us=0;      // applies before this tick; microseconds since start
+  RecKind kind=REC_END;
+  int key=0, W=0, H=0;
+};
+
+// Appends events as they happen; each one is flushed so a crash keeps the log.
+struct Recorder {
+  using clock = std::chrono::steady_clock;
+  FILE* f=nullptr;
+  clock::time_point t0;
+  long long lastTick=0, lastUs=0;
+
+  // Header from the current cfg, types, palette and terminal size.
+  bool open(const char* path);
+  void key(long long tick, int ch);
+  void resize(long long tick, int W, int H);
+  void end(long long tick);
+private:
+  void event(long long tick, RecKind kind);
+};
+
+// Reads a log through mmap (a plain read on Windows).
+struct Replay {
+  RecHeader hdr{};
+  const unsigned char* data=nullptr;
+  size_t size=0, pos=0;
+  std::string buf;             // non-mmap fallback storage
+
+  ~Replay();
+  bool open(const char* path, std::string& err);
+  // Seed, config, types, palette and canvas size from the header.
+  void apply_config() const;
+  // Next event; false at the end of the log (or on a truncated one).
+  bool next(RecEvent& e);
+private:
+  long long tick=0, us=0;
+  bool mapped=false;
+};
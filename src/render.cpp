@@ -0,0 +1,124 @@
+// render.cpp — render thread loop and its wake channel
+
+#include "render.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <unistd.h>
+#endif
+#if defined(__linux__)
+  #include <sys/eventfd.h>
+#endif
+
+#include "metrics.hpp"
+#include "screen.hpp"
+#include "term.hpp"
+
+using namespace std;
+
+bool Renderer::open(){
+#if defined(__linux__)
+  rfd=wfd=eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+  return rfd>=0;
+#elif !defined(_WIN32)
+  int p[2];
+  if (pipe(p)!=0) return false;
+  for (int fd: p){ fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0)|O_NONBLOCK); fcntl(fd, F_SETFD, FD_CLOEXEC); }
+  rfd=p[0]; wfd=p[1];
+  return true;
+#else
+  return true;
+#endif
+}
+
+void Renderer::close(){
+#ifndef _WIN32
+  if (wfd>=0 && wfd!=rfd) ::close(wfd);
+  if (rfd>=0) ::close(rfd);
+#endif
+  rfd=wfd=-1;
+}
+
+void Renderer::wake(){
+#ifndef _WIN32
+  // A full eventfd counter or pipe already means "awake": EAGAIN is fine.
+  const uint64_t one=1;
+  while (wfd>=0 && ::write(wfd, &one, wfd==rfd ? sizeof one : 1)<0 && errno==EINTR) {}
+#endif
+}
+
+void Renderer::settle(){
+#ifndef _WIN32
+  char b[64];
+  // One read resets an eventfd; a pipe is read until empty.
+  while (rfd>=0 && ::read(rfd, b, sizeof b)>0 && rfd!=wfd) {}
+#endif
+}
+
+void Renderer::run(const atomic<bool>& stop){
+  using clk=chrono::steady_clock;
+  Out& out=term.out;
+  clk::time_point quitBy{};
+  Overlay overlay;
+  string stats;
+  stats.reserve(256);
+  unsigned statsSeen=0;
+  bool shown=false;
+#ifdef _WIN32
+  int idle=0;
+#endif
+  while (true){
+    // Wakes are consumed before looking at the state they announce, so none is lost.
+    settle();
+    const bool stopping=stop.load(memory_order_acquire);
+    int waitMs=rfd>=0 ? -1 : 1;     // without open(), poll the ring every millisecond
+    if (stopping){
+      if (quitBy==clk::time_point{}) quitBy=clk::now()+QUIT_GRACE;
+      else if (clk::now()>=quitBy){ out.abandon(); break; }
+      if (rfd>=0) waitMs=max(1, (int)chrono::duration_cast<chrono::milliseconds>(quitBy-clk::now()).count());
+    }
+    if (out.backlog() > out.lowWater()){ out.drain(waitMs, rfd); continue; }
+    // The stats line comes off before the deltas land and goes back on after them.
+    const bool show=showStats.load(memory_order_relaxed) && metrics;
+    const bool restat=show && metrics->overlay(statsSeen, stats);
+    if (ring.front() || restat || show!=shown){
+      const auto a=clk::now();
+      int got=0;
+      term.syncBegin();
+      overlay.lift(screen);
+      while (Frame* f=ring.front()){ apply_frame(*f); ring.pop(); ++got; }
+      if (show) overlay.lay(screen, stats, screen.H-1);
+      shown=show;
+      screen.flush();
+      term.syncEnd();
+      const auto e=clk::now();
+      const long long bytes0=out.bytes;
+      out.commit();
+      const int merged=max(0, got-1);
+      ++flushes; coalesced+=merged;
+#ifdef _WIN32
+      idle=0;
+#endif
+      if (metrics)
+        metrics->frame((uint64_t)chrono::nanoseconds(e-a).count(), (uint64_t)chrono::nanoseconds(clk::now()-e).count(),
+                       out.bytes-bytes0, merged, out.backlog());
+      continue;
+    }
+    if (out.backlog()){ out.drain(waitMs, rfd); continue; }
+    if (stopping) break;
+#ifndef _WIN32
+    pollfd p{rfd, POLLIN, 0};
+    poll(&p, 1, waitMs);
+#else
+    if (++idle<64) this_thread::yield();
+    else this_thread::sleep_for(chrono::microseconds(500));
+#endif
+  }
+}
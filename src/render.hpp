@@ -0,0 +1,35 @@
+// render.hpp — render thread: fold queued deltas into the screen, encode and write frames
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+struct Metrics;
+
+// On quit, a terminal that is behind gets this long before its backlog is dropped.
+constexpr auto QUIT_GRACE = std::chrono::milliseconds(100);
+
+// Consumer side of the frame ring. run() drains every queued delta, then encodes and
+// writes one frame. While the terminal is behind, nothing new is encoded: deltas pile
+// up in the ring (and the pending frame) and go out later as one coalesced diff.
+// Between frames the thread sleeps until wake() or, with output queued, until the
+// terminal takes more (POSIX: eventfd on Linux, a self-pipe elsewhere; Windows polls).
+struct Renderer {
+  Metrics* metrics=nullptr;             // per-frame timings and the stats line, optional
+  std::atomic<bool> showStats{false};   // lay the metrics line over the bottom row
+  long long flushes=0, coalesced=0;     // output counters for the exit summary (render thread only)
+
+  // Call before starting the thread; false if no wake channel could be made.
+  bool open();
+  void close();
+  ~Renderer(){ close(); }
+  // From any thread, after a ring.push or anything else run() must notice
+  // (the stats line toggled or rolled, stop set).
+  void wake();
+  void run(const std::atomic<bool>& stop);
+
+private:
+  int rfd=-1, wfd=-1;                   // same fd for an eventfd
+  void settle();                        // consume pending wakes
+};
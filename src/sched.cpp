@@ -0,0 +1,48 @@
+// sched.cpp — fixed-timestep frame scheduler
+
+#include "sched.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <thread>
+
+using namespace std;
+
+void Scheduler::start(int f){ fps=0; setFps(f); next=clock::now(); frames=late=skipped=0; worst={}; }
+
+void Scheduler::setFps(int f){
+  if (f==fps) return;
+  fps=f; period=chrono::duration_cast<clock::duration>(chrono::nanoseconds(1000000000LL/max(1,f)));
+  next=clock::now()+period;
+}
+
+void Scheduler::sleep_until_abs(clock::time_point t){
+#if defined(__linux__)
+  const auto ns=chrono::duration_cast<chrono::nanoseconds>(t.time_since_epoch()).count();
+  timespec ts{ (time_t)(ns/1000000000LL), (long)(ns%1000000000LL) };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)==EINTR) {}
+#else
+  this_thread::sleep_until(t);
+#endif
+}
+
+int Scheduler::wait(){
+  auto now=clock::now();
+  long long behind=0;
+  if (now<next){ sleep_until_abs(next); now=clock::now(); }
+  else if ((behind=(now-next)/period) > 0) ++late;
+  int n=1;
+  if (catchUp){ n += (int)min<long long>(behind, maxCatchUp); skipped += behind-(n-1); }
+  else skipped += behind;
+  next += period*(behind+1);
+  if (frames){ worst=max(worst, now-last); } else first=now;
+  last=now; frames+=n;
+  return n;
+}
+
+double Scheduler::measured_ms() const {
+  return frames>1 ? chrono::duration<double,milli>(last-first).count()/(double)(frames-1) : 0.0;
+}
+
+double Scheduler::target_ms() const { return chrono::duration<double,milli>(period).count(); }
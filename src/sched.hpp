@@ -0,0 +1,28 @@
+// sched.hpp — fixed-timestep frame scheduler
+
+#pragma once
+
+#include <chrono>
+
+// Fixed-timestep frame scheduler on absolute steady_clock deadlines.
+// Deadlines stay on the period grid, so work time never stretches the cadence.
+struct Scheduler {
+  using clock = std::chrono::steady_clock;
+  clock::duration period{};
+  clock::time_point next{}, first{}, last{};
+  int fps=0;
+  bool catchUp=false;          // run missed ticks back-to-back instead of dropping them
+  int maxCatchUp=4;
+  long long frames=0, late=0, skipped=0;
+  clock::duration worst{};
+
+  void start(int f);
+  void setFps(int f);
+  // Restart the grid one period from now, e.g. after the loop was paused.
+  void rebase(){ next=clock::now()+period; }
+  static void sleep_until_abs(clock::time_point t);
+  // Block until the next deadline; returns how many simulation ticks are due (>=1).
+  int wait();
+  double measured_ms() const;
+  double target_ms() const;
+};
@@ -0,0 +1,188 @@
+// screen.cpp — cell grid diffing and frame encoding
+
+#include "screen.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+Screen screen;
+Frame pending;
+FrameRing ring;
+bool asciiGlyphs=false;
+
+// (fg, bold) buckets plus one for blanks
+static constexpr int SGR_GROUPS = 1 + 17*2;
+
+void Screen::resize(int w, int h){
+  W=max(0,w); H=max(0,h);
+  back.assign((size_t)W*H, Cell{}); front.assign((size_t)W*H, Cell{});
+  lo.assign(H, W); hi.assign(H, -1);
+  wipe=false;
+  tokens.assign((size_t)GLYPH_IDS*SGR_GROUPS, Token{});
+}
+
+void Screen::reshape(int w, int h){
+  const int ow=W, oh=H;
+  w=max(0,w); h=max(0,h);
+  const int cw=min(ow,w), ch=min(oh,h);
+  vector<Cell> nb((size_t)w*h), nf((size_t)w*h);
+  for (int y=0;y<ch;y++){
+    copy_n(back.begin()+(size_t)y*ow, cw, nb.begin()+(size_t)y*w);
+    copy_n(front.begin()+(size_t)y*ow, cw, nf.begin()+(size_t)y*w);
+  }
+  back.swap(nb); front.swap(nf);
+  lo.resize(h, w); hi.resize(h, -1);
+  for (int y=0;y<ch;y++){ lo[y]=min(lo[y], w); hi[y]=min(hi[y], w-1); }
+  W=w; H=h;
+  term.canvas(w, h);
+  if (w>ow) for (int y=0;y<ch;y++){ term.mv(ow, y); term.out.put("\033[K"); }
+  if (h>oh){ term.mv(0, oh); term.out.put("\033[J"); }
+}
+
+void Screen::clear(){
+  fill(back.begin(), back.end(), Cell{}); fill(front.begin(), front.end(), Cell{});
+  fill(lo.begin(), lo.end(), W); fill(hi.begin(), hi.end(), -1);
+  wipe=true;
+}
+
+// SGR group of a cell: 0 for blanks (no SGR needed), else (fg, bold) bucket.
+static inline int sgr_group(const Cell& c){
+  if (!c.glyph) return 0;
+  const int f = c.color==39 ? 0 : (c.color>=90 ? 9+c.color-90 : 1+c.color-30);
+  return 1 + f*2 + (c.attr & A_BOLD ? 1 : 0);
+}
+// Bytes to reprint a cell under the current SGR state, or -1 if it would need an SGR change.
+template <bool Ascii> static inline int cell_cost(const Cell& c){
+  if (!c.glyph) return 1;
+  if (c.color!=term.sfg || (int)(c.attr & A_BOLD)!=term.sbold) return -1;
+  return Ascii ? 1 : glyph_of(c.glyph).n;
+}
+template <bool Ascii> static inline void put_glyph(uint16_t id){
+  const Glyph& g=glyph_of(id);
+  if (Ascii) term.out.put(g.b[0]); else term.out.put(g.b, g.n);
+}
+// Same bytes Term::sgr would emit for a foreground-only change, followed by the glyph.
+static const Token& token(const Cell& c){
+  if (screen.tokens.empty()) screen.tokens.assign((size_t)GLYPH_IDS*SGR_GROUPS, Token{});
+  Token& t=screen.tokens[(size_t)c.glyph*SGR_GROUPS + sgr_group(c)];
+  if (!t.n){
+    const Glyph& g=glyph_of(c.glyph);
+    t.b[0]='\033'; t.b[1]='['; t.n=2;
+    t.n+=put_uint(t.b+t.n, c.color); t.b[t.n++]='m';
+    memcpy(t.b+t.n, g.b, g.n); t.n+=g.n;
+  }
+  return t;
+}
+template <bool Ascii> static inline void emit_cell(const Cell& c){
+  const int bold=c.attr & A_BOLD;
+  if (!c.glyph) term.out.put(' ');
+  else if (c.color==term.sfg && bold==term.sbold) put_glyph<Ascii>(c.glyph);
+  else if (bold==term.sbold && term.sfg>=0){ const Token& t=token(c); term.out.put(t.b, t.n); term.sfg=c.color; }
+  else { term.sgr(c.color, bold); put_glyph<Ascii>(c.glyph); }
+  term.advance(screen.W);
+}
+
+void Screen::flush(){
+  if (asciiGlyphs) flush_as<true>(); else flush_as<false>();
+}
+
+template <bool Ascii> void Screen::flush_as(){
+  if (wipe){ term.out.put("\033[2J"); wipe=false; }
+  order.clear();
+  for (int y=0;y<H;y++){
+    if (lo[y]>hi[y]) continue;
+    for (int x=lo[y]; x<=hi[y]; x++){
+      const size_t i=(size_t)y*W+x;
+      if (back[i]!=front[i]) order.push_back((uint32_t)i);
+    }
+    lo[y]=W; hi[y]=-1;
+  }
+  if (order.empty()) return;
+
+  // Stable counting sort by SGR group, starting with the group the terminal is already in.
+  size_t start[SGR_GROUPS+1]={};
+  for (uint32_t i: order) ++start[sgr_group(back[i])+1];
+  for (int g=0; g<SGR_GROUPS; g++) start[g+1]+=start[g];
+  size_t pos[SGR_GROUPS]; copy(start, start+SGR_GROUPS, pos);
+  sorted.resize(order.size());
+  for (uint32_t i: order) sorted[pos[sgr_group(back[i])]++]=i;
+  int first=0;
+  if (term.sfg>=0 && term.sbold>=0){
+    Cell probe; probe.glyph=1; probe.color=(uint8_t)term.sfg; probe.attr=term.sbold? A_BOLD:0;
+    first=sgr_group(probe);
+  }
+
+  char scratch[64];
+  for (int k=0;k<SGR_GROUPS;k++){
+    const int g=(first+k)%SGR_GROUPS;
+    for (size_t j=start[g]; j<start[g+1]; j++){
+      const uint32_t i=sorted[j];
+      const int x=(int)(i%W), y=(int)(i/W);
+      // Short forward gap on this row: reprinting the unchanged cells may beat a move.
+      if (term.cy==y && term.cx>=0 && term.cx<x && x-term.cx<=8){
+        const size_t r=(size_t)y*W;
+        int cost=0;
+        for (int c=term.cx; c<x && cost>=0; c++){ int b=cell_cost<Ascii>(front[r+c]); cost = b<0? -1: cost+b; }
+        if (cost>=0 && cost < term.plan(x,y,scratch)) for (int c=term.cx; c<x;) emit_cell<Ascii>(front[r+c++]);
+      }
+      term.mv(x,y);
+      // Identical dirty cells following on this row: one REP, or one ECH for blanks.
+      size_t e=j+1;
+      if (term.caps.rep || term.caps.ech)
+        while (e<start[g+1] && sorted[e]==sorted[e-1]+1 && sorted[e]%W!=0 && back[sorted[e]]==back[i]) ++e;
+      const int run=(int)(e-j);
+      if (run>1 && !back[i].glyph && term.caps.ech && put_csi(scratch, run, 'X') < run){
+        term.out.put(scratch, (size_t)put_csi(scratch, run, 'X'));
+      } else {
+        emit_cell<Ascii>(back[i]);
+        const int rep=run>1 && term.caps.rep ? put_csi(scratch, run-1, 'b') : 0;
+        if (rep && rep < (run-1)*cell_cost<Ascii>(back[i])){ term.out.put(scratch, (size_t)rep); term.advance(W, run-1); }
+        else e=j+1;
+      }
+      for (size_t t=j; t<e; t++) front[sorted[t]]=back[sorted[t]];
+      j=e-1;
+    }
+  }
+}
+
+void Overlay::lift(Screen& s){
+  if (y<0) return;
+  if (y<s.H) for (size_t x=0; x<under.size() && (int)x<s.W; x++) s.put((int)x, y, under[x]);
+  y=-1;
+}
+
+void Overlay::lay(Screen& s, const string& text, int row){
+  lift(s);
+  if (row<0 || row>=s.H) return;
+  const size_t w=min(text.size(), (size_t)s.W);
+  under.reserve((size_t)s.W);    // a longer line later must not reallocate mid-run
+  under.assign(s.back.begin()+(size_t)row*s.W, s.back.begin()+(size_t)row*s.W+w);
+  for (size_t x=0;x<w;x++){ Cell c; c.glyph=text_glyph(text[x]); s.put((int)x, row, c); }
+  y=row;
+}
+
+void Frame::compact(){
+  stamp.resize((size_t)W*H);
+  if (++gen==0){ fill(stamp.begin(), stamp.end(), 0); gen=1; }
+  size_t k=puts.size();
+  for (size_t j=puts.size(); j-- > 0;){
+    const Put& p=puts[j];
+    if (p.x>=W || p.y>=H) continue;
+    uint32_t& m=stamp[(size_t)p.y*W+p.x];
+    if (m==gen) continue;
+    m=gen; puts[--k]=p;
+  }
+  puts.erase(puts.begin(), puts.begin()+k);
+}
+
+void apply_frame(const Frame& f){
+  if ((f.W!=screen.W || f.H!=screen.H) && !f.wipe && screen.W>0 && screen.H>0) screen.reshape(f.W, f.H);
+  else if (f.W!=screen.W || f.H!=screen.H){
+    screen.resize(f.W, f.H); term.canvas(f.W, f.H);
+    term.out.put("\033[2J");
+  }
+  else if (f.wipe) screen.clear();
+  for (const Put& p: f.puts) screen.put(p.x, p.y, p.c);
+}
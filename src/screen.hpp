@@ -0,0 +1,115 @@
+// screen.hpp — cell grid with damage tracking, frame deltas and the sim -> render handoff
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "core.hpp"
+
+// Screen model: back buffer (wanted) vs front buffer (on terminal), dirty span per row
+enum Attr : uint8_t { A_BOLD=1 };
+struct Cell {
+  uint16_t glyph=0;          // 0 = blank, else 1 + type*16 + (idx-1)
+  uint8_t  color=39;         // SGR foreground code as shown (39 = default)
+  uint8_t  attr=0;
+  bool operator==(const Cell& o) const { return glyph==o.glyph && color==o.color && attr==o.attr; }
+  bool operator!=(const Cell& o) const { return !(*this==o); }
+};
+inline uint16_t glyph_id(int type, int idx){ return (uint16_t)(1 + type*16 + (idx-1)); }
+inline const Glyph& glyph_of(uint16_t id){
+  static constexpr Glyph blank = glyph(" ");
+  return id ? T[(id-1)/16].g[(id-1)%16] : blank;
+}
+constexpr int GLYPH_IDS = 1 + TYPE_SLOTS*16;
+inline uint16_t text_glyph(char ch){
+  const int k = ch>' ' && ch<='~' ? ch-' ' : 0;
+  return glyph_id(TEXT_TYPE + k/16, 1 + k%16);
+}
+// Every glyph the active sets draw is a single byte; the encoder then skips glyph
+// lengths. spawn_pipes() keeps it current.
+extern bool asciiGlyphs;
+
+// Pre-encoded "SGR foreground + glyph" bytes for one (type, turn, color, bold)
+struct Token { char b[11]; uint8_t n=0; };
+
+struct Screen {
+  int W=0, H=0;
+  std::vector<Cell> back, front;
+  std::vector<int> lo, hi;      // dirty columns [lo,hi] per row; lo>hi means clean
+  bool wipe=false;              // full clear pending before next diff
+  std::vector<uint32_t> order, sorted;   // flush scratch, reused across frames
+  std::vector<Token> tokens;    // [glyph id][SGR group], built on first use
+
+  void resize(int w, int h);
+  // New size keeping what is on screen: crop on shrink, blanks on grow. Only the
+  // exposed strips are repainted, with EL right of the old width and ED below it.
+  void reshape(int w, int h);
+  void put(int x, int y, Cell c){
+    if (x<0 || x>=W || y<0 || y>=H) return;
+    const size_t i=(size_t)y*W+x;
+    back[i]=c;
+    if (c!=front[i]){ if (x<lo[y]) lo[y]=x; if (x>hi[y]) hi[y]=x; }
+  }
+  // Drop everything; the terminal gets a single ED instead of per-cell blanks.
+  void clear();
+  // Emit changed cells grouped by SGR state, row-major within a group, and sync front to back.
+  void flush();
+  template <bool Ascii> void flush_as();   // flush() for one glyph width
+};
+extern Screen screen;
+
+// A line of text laid over the canvas through the diff path. lift() puts back the canvas
+// cells it covered before new deltas land; lay() saves them and writes the text on top.
+// An unchanged line re-emits nothing, and hiding it repaints only the cells it covered.
+struct Overlay {
+  std::vector<Cell> under;
+  int y=-1;                     // row laid, -1 = none
+  void lift(Screen& s);
+  void lay(Screen& s, const std::string& text, int row);
+};
+
+// Frame delta handed from the simulation to the renderer
+struct Put { uint16_t x, y; Cell c; };
+struct Frame {
+  int W=0, H=0;
+  bool wipe=false;         // canvas cleared before these puts
+  std::vector<Put> puts;
+  std::vector<uint32_t> stamp;  // compaction scratch
+  uint32_t gen=0;
+  void put(int x, int y, Cell c){ puts.push_back(Put{(uint16_t)x,(uint16_t)y,c}); }
+  void clear(){ puts.clear(); wipe=true; }
+  void reset(){ puts.clear(); wipe=false; }
+  // Keep only the last put per cell (in order); bounds a delta the renderer is not taking.
+  void compact();
+};
+
+// Lock-free single-producer/single-consumer ring of frame deltas.
+// Slots swap vectors with the producer, so steady state does not allocate.
+struct FrameRing {
+  static constexpr size_t N=4;
+  Frame slot[N];
+  std::atomic<size_t> head{0}, tail{0};
+  bool push(Frame& f){
+    const size_t h=head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == N) return false;
+    Frame& s=slot[h%N];
+    std::swap(s.puts, f.puts); s.W=f.W; s.H=f.H; s.wipe=f.wipe;
+    head.store(h+1, std::memory_order_release);
+    f.reset();
+    return true;
+  }
+  Frame* front(){
+    const size_t t=tail.load(std::memory_order_relaxed);
+    return t==head.load(std::memory_order_acquire) ? nullptr : &slot[t%N];
+  }
+  void pop(){ tail.store(tail.load(std::memory_order_relaxed)+1, std::memory_order_release); }
+};
+extern Frame pending;
+extern FrameRing ring;
+
+// Render side: fold a delta into the screen; a new canvas size keeps the content unless the frame wipes.
+void apply_frame(const Frame& f);
@@ -0,0 +1,340 @@
+// serve.cpp — broadcast server and viewer
+
+#include "serve.hpp"
+#include "core.hpp"
+#include "events.hpp"
+#include "sched.hpp"
+#include "screen.hpp"
+#include "term.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+  #include <cerrno>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifndef _WIN32
+
+// Past QUEUE_CAP unsent bytes a viewer stops getting diffs; once it is back under
+// QUEUE_LOW it resyncs from a keyframe. No progress for STALL_LIMIT drops it.
+static constexpr size_t QUEUE_CAP = 1u<<20, QUEUE_LOW = 64u<<10;
+static constexpr auto STALL_LIMIT = chrono::seconds(5);
+static constexpr int MAX_SIDE = 1000;
+static constexpr auto QUIT_DRAIN = chrono::milliseconds(200);
+
+using clk = chrono::steady_clock;
+
+struct Viewer {
+  int fd=-1;
+  int group=-1;                // -1 until the first size line
+  string in;                   // partial size line
+  vector<char> q;              // bytes not yet taken by the socket, from off
+  size_t off=0;
+  bool needKey=true;
+  clk::time_point progress;
+  size_t backlog() const { return q.size()-off; }
+};
+
+struct Group {
+  int W=0, H=0, members=0;
+  Screen scr;
+  Term t;
+  vector<char> diff, key;      // this frame's encodings
+  bool keyReady=false;
+  vector<Cell> blank;          // keyframe scratch
+};
+
+struct ServeStats { long long served=0, frames=0, keyframes=0, downgrades=0, dropped=0; size_t peakGroups=0; };
+
+// The encoder works on the global screen and term; a group's pair is swapped in while it encodes.
+struct Bind {
+  Group& g;
+  explicit Bind(Group& g): g(g){ swap(screen, g.scr); swap(term, g.t); }
+  ~Bind(){ swap(screen, g.scr); swap(term, g.t); }
+};
+
+static volatile sig_atomic_t g_stop=0;
+static void on_stop(int){ g_stop=1; }
+
+static void set_nonblock(int fd){ fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK); fcntl(fd, F_SETFD, FD_CLOEXEC); }
+
+static bool unix_addr(const char* path, sockaddr_un& a){
+  a=sockaddr_un{}; a.sun_family=AF_UNIX;
+  if (strlen(path)>=sizeof a.sun_path){ errno=ENAMETOOLONG; return false; }
+  strcpy(a.sun_path, path);
+  return true;
+}
+
+static int listen_on(const char* path){
+  sockaddr_un a;
+  if (!unix_addr(path, a)) return -1;
+  // A live server keeps its socket; a stale one left by a crash is replaced.
+  // Anything else at the path (a regular file, say) is never removed.
+  int fd=socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd<0) return -1;
+  if (connect(fd, (sockaddr*)&a, sizeof a)==0){ close(fd); errno=EADDRINUSE; return -1; }
+  close(fd);
+  struct stat st;
+  if (lstat(path, &st)==0){
+    if (!S_ISSOCK(st.st_mode)){ errno=EEXIST; return -1; }
+    unlink(path);
+  }
+  fd=socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd<0) return -1;
+  if (bind(fd, (sockaddr*)&a, sizeof a)!=0 || listen(fd, 64)!=0){ const int e=errno; close(fd); errno=e; return -1; }
+  set_nonblock(fd);
+  return fd;
+}
+
+// Everything the simulation has drawn, at canvas size; new groups start from it.
+struct Canvas {
+  int W=0, H=0;
+  vector<Cell> cells;
+  void reshape(int w, int h){
+    vector<Cell> n((size_t)w*h);
+    for (int y=0;y<min(h,H);y++) copy_n(cells.begin()+(size_t)y*W, min(w,W), n.begin()+(size_t)y*w);
+    cells.swap(n); W=w; H=h;
+  }
+  void apply(const Frame& f){
+    if (f.wipe) fill(cells.begin(), cells.end(), Cell{});
+    for (const Put& p: f.puts) if (p.x<W && p.y<H) cells[(size_t)p.y*W+p.x]=p.c;
+  }
+};
+
+// Every frame starts from an unknown cursor and SGR state, so a viewer can join between any two.
+static void encode(Group& g, const Frame& f){
+  Bind b(g);
+  term.cx=term.cy=-1; term.sfg=term.sbold=-1;
+  if (f.wipe) screen.clear();
+  for (const Put& p: f.puts) screen.put(p.x, p.y, p.c);
+  screen.flush();
+  term.out.commit();
+  g.diff.swap(term.out.mem); term.out.mem.clear();
+  g.keyReady=false;
+}
+
+// Full repaint of what the group shows: diff the screen against a blank one.
+static void build_key(Group& g){
+  Bind b(g);
+  g.blank.assign(screen.front.size(), Cell{});
+  swap(screen.front, g.blank);
+  fill(screen.lo.begin(), screen.lo.end(), 0); fill(screen.hi.begin(), screen.hi.end(), screen.W-1);
+  term.cx=term.cy=-1; term.sfg=term.sbold=-1;
+  term.hideCursor(); term.resetAttrs(); term.out.put("\033[2J");
+  screen.flush();
+  term.out.commit();
+  g.key.swap(term.out.mem); term.out.mem.clear();
+  g.keyReady=true;
+}
+
+static void enqueue(Viewer& v, const vector<char>& b){
+  if (v.off==v.q.size()){ v.q.clear(); v.off=0; }
+  else if (v.off > v.q.size()/2){ v.q.erase(v.q.begin(), v.q.begin()+(long)v.off); v.off=0; }
+  v.q.insert(v.q.end(), b.begin(), b.end());
+}
+
+// Send what the socket takes without blocking; false if the viewer is gone.
+static bool send_queue(Viewer& v){
+  while (v.backlog()){
+    const ssize_t n=send(v.fd, v.q.data()+v.off, v.backlog(), 0);
+    if (n>0){ v.off+=(size_t)n; v.progress=clk::now(); continue; }
+    if (n<0 && errno==EINTR) continue;
+    return n<0 && (errno==EAGAIN || errno==EWOULDBLOCK);
+  }
+  v.progress=clk::now();
+  return true;
+}
+
+int run_serve(const char* path, const ServeOptions& o){
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, on_stop); signal(SIGTERM, on_stop);
+  const int lfd=listen_on(path);
+  if (lfd<0){ cerr << "Error: cannot serve on " << path << ": " << strerror(errno) << ".\n"; return 1; }
+
+  vector<Viewer> viewers;
+  vector<unique_ptr<Group>> groups;
+  vector<pollfd> pfds;
+  ServeStats st;
+  Canvas canvas;
+  Pipes S;
+  long long last_reset=0;
+  bool started=false;
+  // Growing canvases start on the first viewer's size; a fixed one starts right away.
+  auto start=[&](int W, int H){
+    term.W=W; term.H=H; pending.W=W; pending.H=H;
+    canvas.reshape(W, H);
+    S=spawn_pipes();
+    started=true;
+  };
+  if (!o.grow) start(o.W, o.H);
+
+  auto join=[&](Viewer& v, int W, int H){
+    W=max(1, min(MAX_SIDE, W)); H=max(1, min(MAX_SIDE, H));
+    if (!started) start(W, H);
+    else if (o.grow && (W>canvas.W || H>canvas.H)){
+      canvas.reshape(max(W, canvas.W), max(H, canvas.H));
+      term.W=pending.W=canvas.W; term.H=pending.H=canvas.H;
+    }
+    if (v.group>=0 && --groups[v.group]->members==0) groups[v.group].reset();
+    v.group=-1; v.needKey=true;
+    for (size_t i=0;i<groups.size() && v.group<0;i++) if (groups[i] && groups[i]->W==W && groups[i]->H==H) v.group=(int)i;
+    if (v.group<0){
+      auto g=make_unique<Group>();
+      g->W=W; g->H=H; g->t.W=W; g->t.H=H; g->t.out.sink=SINK_MEM;
+      g->t.lfcr=false;   // a viewer's tty may not map LF to CRLF
+      g->scr.resize(W, H); g->t.canvas(W, H);
+      for (int y=0;y<min(H, canvas.H);y++)
+        for (int x=0;x<min(W, canvas.W);x++) g->scr.back[(size_t)y*W+x]=g->scr.front[(size_t)y*W+x]=canvas.cells[(size_t)y*canvas.W+x];
+      size_t k=0;
+      while (k<groups.size() && groups[k]) ++k;
+      if (k==groups.size()) groups.emplace_back();
+      groups[k]=move(g); v.group=(int)k;
+    }
+    ++groups[v.group]->members;
+    st.peakGroups=max(st.peakGroups, (size_t)count_if(groups.begin(), groups.end(), [](const unique_ptr<Group>& g){ return (bool)g; }));
+  };
+  auto drop=[&](Viewer& v){
+    if (v.group>=0 && --groups[v.group]->members==0) groups[v.group].reset();
+    close(v.fd); v.fd=-1; v.group=-1;
+  };
+
+  cout << "Serving on " << path << "  (Ctrl-C stops)\n" << flush;
+  Scheduler sched; sched.catchUp=cfg.catchUp; sched.start(cfg.fps);
+  char buf[4096];
+  while (!g_stop){
+    pfds.clear();
+    pfds.push_back(pollfd{lfd, POLLIN, 0});
+    for (const Viewer& v: viewers) pfds.push_back(pollfd{v.fd, (short)(POLLIN | (v.backlog()? POLLOUT: 0)), 0});
+    const auto wait=chrono::duration_cast<chrono::milliseconds>(sched.next-clk::now()+chrono::microseconds(999)).count();
+    if (poll(pfds.data(), (nfds_t)pfds.size(), (int)max<long long>(0, wait))<0 && errno!=EINTR) break;
+
+    for (size_t i=0;i<viewers.size();i++){
+      Viewer& v=viewers[i];
+      const short re=pfds[i+1].revents;
+      if (re & POLLIN){
+        const ssize_t n=recv(v.fd, buf, sizeof buf, 0);
+        if (n<=0){ if (n==0 || (errno!=EAGAIN && errno!=EINTR)) drop(v); continue; }
+        v.in.append(buf, (size_t)n);
+        for (size_t e; v.fd>=0 && (e=v.in.find('\n'))!=string::npos; v.in.erase(0, e+1)){
+          int W=0, H=0;
+          if (sscanf(v.in.c_str(), "%d %d", &W, &H)==2) join(v, W, H);
+        }
+        if (v.fd>=0 && v.in.size()>256) drop(v);
+      }
+      else if (re & (POLLERR|POLLHUP)){ drop(v); continue; }
+      if (v.fd>=0 && (re & POLLOUT) && !send_queue(v)) drop(v);
+    }
+    if (pfds[0].revents & POLLIN){
+      for (int fd; (fd=accept(lfd, nullptr, nullptr))>=0;){
+        set_nonblock(fd);
+        Viewer v; v.fd=fd; v.progress=clk::now();
+        viewers.push_back(move(v)); ++st.served;
+      }
+    }
+
+    if (clk::now()>=sched.next){
+      const int ticks=sched.wait();
+      if (started){
+        for (int k=0;k<ticks;k++){ step_all(S, last_reset); ++st.frames; }
+        canvas.apply(pending);
+        for (auto& g: groups) if (g) encode(*g, pending);
+        pending.reset();
+        for (Viewer& v: viewers){
+          if (v.fd<0 || v.group<0) continue;
+          Group& g=*groups[v.group];
+          if (v.needKey){
+            if (v.backlog()>QUEUE_LOW) continue;
+            if (!g.keyReady) build_key(g);
+            enqueue(v, g.key); v.needKey=false; ++st.keyframes;
+          }
+          else if (v.backlog()+g.diff.size() > QUEUE_CAP){ v.needKey=true; ++st.downgrades; continue; }
+          else enqueue(v, g.diff);
+          if (!send_queue(v)) drop(v);
+        }
+      }
+    }
+    const auto now=clk::now();
+    for (Viewer& v: viewers)
+      if (v.fd>=0 && v.backlog() && now-v.progress>STALL_LIMIT){ drop(v); ++st.dropped; }
+    viewers.erase(remove_if(viewers.begin(), viewers.end(), [](const Viewer& v){ return v.fd<0; }), viewers.end());
+  }
+
+  // Queued frames still go out, briefly, so viewers are not left mid-sequence.
+  for (auto until=clk::now()+QUIT_DRAIN; clk::now()<until;){
+    pfds.clear();
+    for (Viewer& v: viewers) if (v.fd>=0 && v.backlog()) pfds.push_back(pollfd{v.fd, POLLOUT, 0});
+    if (pfds.empty() || poll(pfds.data(), (nfds_t)pfds.size(), 10)<0) break;
+    for (Viewer& v: viewers) if (v.fd>=0 && v.backlog() && !send_queue(v)) drop(v);
+  }
+  for (Viewer& v: viewers) if (v.fd>=0) close(v.fd);
+  close(lfd);
+  unlink(path);
+  char line[200];
+  snprintf(line, sizeof line, "Served %lld viewers  %lld frames  peak %zu sizes  %lld keyframes  %lld downgrades  %lld dropped\n",
+           st.served, st.frames, st.peakGroups, st.keyframes, st.downgrades, st.dropped);
+  cout << line;
+  return 0;
+}
+
+int run_view(const char* path){
+  sockaddr_un a;
+  const int fd=socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd<0 || !unix_addr(path, a) || connect(fd, (sockaddr*)&a, sizeof a)!=0){
+    cerr << "Error: cannot connect to " << path << ": " << strerror(errno) << ".\n";
+    if (fd>=0) close(fd);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  events.init();
+  Term t; term=t; term.init();
+  term.clear();
+  events.watch(fd);
+  long long writes=0;
+  auto send_size=[&]{
+    char s[32];
+    const int n=snprintf(s, sizeof s, "%d %d\n", term.W, term.H);
+    return write_all(fd, s, (size_t)n, &writes);
+  };
+  bool ended=!send_size();
+  char buf[1<<16];
+  while (!ended){
+    const unsigned ev=events.wait(Events::clock::time_point::max());
+    if (ev & Events::EV_KEY) break;
+    if (term.checkResize() && !send_size()) ended=true;
+    if (ev & Events::EV_FD){
+      const ssize_t n=recv(fd, buf, sizeof buf, 0);
+      if (n>0) write_all(STDOUT_FILENO, buf, (size_t)n, &writes);
+      else if (n==0 || (errno!=EAGAIN && errno!=EINTR)) ended=true;
+    }
+  }
+  close(fd);
+  events.close();
+  term.sfg=term.sbold=-1;   // the stream left the attributes unknown
+  term.restore();
+  term.clear();
+  if (ended) cerr << "The server closed the stream.\n";
+  return 0;
+}
+
+#else
+
+int run_serve(const char*, const ServeOptions&){ cerr << "Error: --serve needs Unix domain sockets.\n"; return 1; }
+int run_view(const char*){ cerr << "Error: --view needs Unix domain sockets.\n"; return 1; }
+
+#endif
@@ -0,0 +1,15 @@
+// serve.hpp — broadcast mode: one simulation streamed to local viewers over a Unix socket
+
+#pragma once
+
+// Protocol: a viewer connects and sends its size as "W H\n", again after every resize.
+// It gets plain terminal output back: a keyframe, then frame diffs.
+// Viewers of one size share a group: one screen and one encode per frame, fanned out
+// to each member's bounded queue, so cost follows the number of distinct sizes.
+struct ServeOptions {
+  int W=80, H=24;              // simulation canvas
+  bool grow=true;              // widen it to the largest viewer (off with --size)
+};
+int run_serve(const char* path, const ServeOptions& o);
+// Thin viewer: send the tty size, copy the stream to stdout; any key quits.
+int run_view(const char* path);
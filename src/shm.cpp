@@ -0,0 +1,171 @@
+// shm.cpp — shared-memory canvas: seqlocked writer and reader
+
+#include "shm.hpp"
+#include "screen.hpp"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static size_t align64(size_t n){ return (n+63) & ~(size_t)63; }
+static string shm_path(const char* name){ return name[0]=='/' ? string(name) : "/"+string(name); }
+
+bool Publisher::map(size_t bytes){
+  if (ftruncate(fd, (off_t)bytes)!=0) return false;
+  void* m=mmap(nullptr, bytes, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if (m==MAP_FAILED) return false;
+  if (base) munmap(base, size);
+  base=(unsigned char*)m; size=bytes;
+  return true;
+}
+
+// An existing segment may only be replaced when it is a pipes segment whose writer
+// has exited; anything else (a live writer, a foreign segment) is left alone.
+static bool stale_segment(const string& name, string& err){
+  const int fd=shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd<0){
+    if (errno==ENOENT) return true;    // gone in the meantime
+    err=strerror(errno); return false;
+  }
+  struct stat st{};
+  void* m=MAP_FAILED;
+  if (fstat(fd, &st)==0 && (size_t)st.st_size>=sizeof(ShmHeader))
+    m=mmap(nullptr, sizeof(ShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (m==MAP_FAILED){ err="exists and is not a pipes segment"; return false; }
+  const ShmHeader& h=*(const ShmHeader*)m;
+  const bool ours=memcmp(h.magic, "PIPESHM", 8)==0;
+  const pid_t pid=(pid_t)h.writerPid;
+  munmap(m, sizeof(ShmHeader));
+  if (!ours || pid<=0){ err="exists and is not a pipes segment"; return false; }
+  if (kill(pid, 0)==0 || errno!=ESRCH){ err="in use by pid "+to_string(pid); return false; }
+  return true;
+}
+
+bool Publisher::open(const char* shmName, int W, int H, size_t pipes, string& err){
+  name=shm_path(shmName);
+  // A fresh segment each run. One left by a crashed writer is replaced (readers still
+  // on it keep their mapping); a running writer's is never taken over.
+  fd=shm_open(name.c_str(), O_CREAT|O_EXCL|O_RDWR, 0644);
+  if (fd<0 && errno==EEXIST){
+    if (!stale_segment(name, err)) return false;
+    shm_unlink(name.c_str());
+    fd=shm_open(name.c_str(), O_CREAT|O_EXCL|O_RDWR, 0644);
+  }
+  if (fd<0){ err=strerror(errno); return false; }
+  const size_t glyphsOff=align64(sizeof(ShmHeader));
+  const size_t pipesOff=align64(glyphsOff + GLYPH_IDS*sizeof(ShmGlyph));
+  const size_t cellsOff=align64(pipesOff + pipes*sizeof(ShmPipe));
+  W=max(W,0); H=max(H,0);
+  if (!map(cellsOff + (size_t)W*H*sizeof(ShmCell))){ err=strerror(errno); close(); return false; }
+  ShmHeader& h=hdr();
+  memcpy(h.magic, "PIPESHM", 8);
+  h.version=SHM_VERSION; h.headerSize=sizeof(ShmHeader);
+  h.writerPid=(uint32_t)getpid(); h.nGlyphs=GLYPH_IDS;
+  h.W=(uint32_t)W; h.H=(uint32_t)H; h.nPipes=(uint32_t)pipes;
+  h.glyphsOff=glyphsOff; h.pipesOff=pipesOff; h.cellsOff=cellsOff;
+  ShmGlyph* g=(ShmGlyph*)(base+glyphsOff);
+  for (int id=0; id<GLYPH_IDS; id++){ const Glyph& s=glyph_of((uint16_t)id); memcpy(g[id].b, s.b, 4); g[id].n=s.n; }
+  h.mapSize.store(size, memory_order_relaxed);
+  h.seq.store(0, memory_order_release);
+  return true;
+}
+
+void Publisher::publish(const Frame& f, size_t from, bool cleared, const Pipes& P, long long frame, long long drawn){
+  if (!base) return;
+  const int W=max(f.W,0), H=max(f.H,0);
+  // Grow first: the mapping may move, and readers learn the new size from mapSize.
+  const size_t need=hdr().cellsOff + (size_t)W*H*sizeof(ShmCell);
+  if (need>size){
+    if (!map(need)) return;
+    hdr().mapSize.store(size, memory_order_release);
+  }
+  ShmHeader& h=hdr();
+  const uint64_t s=h.seq.load(memory_order_relaxed);
+  h.seq.store(s+1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  ShmCell* c=(ShmCell*)(base+h.cellsOff);
+  if ((int)h.W!=W || (int)h.H!=H){
+    // Same rule as the screen: keep the overlap, blank the rest.
+    const int ow=(int)h.W, oh=(int)h.H;
+    scratch.assign(c, c+(size_t)ow*oh);
+    fill(c, c+(size_t)W*H, ShmCell{});
+    for (int y=0;y<min(H,oh);y++) copy_n(scratch.begin()+(size_t)y*ow, min(W,ow), c+(size_t)y*W);
+    h.W=(uint32_t)W; h.H=(uint32_t)H;
+  }
+  if (cleared) fill(c, c+(size_t)W*H, ShmCell{});
+  for (size_t k=from; k<f.puts.size(); k++){
+    const Put& p=f.puts[k];
+    if (p.x<W && p.y<H) c[(size_t)p.y*W+p.x]=ShmCell{p.c.glyph, p.c.color, p.c.attr};
+  }
+  ShmPipe* q=(ShmPipe*)(base+h.pipesOff);
+  const size_t n=min(P.size(), (size_t)h.nPipes);
+  for (size_t i=0;i<n;i++)
+    q[i]=ShmPipe{P.x[i], P.y[i], (uint8_t)P.in[i], (uint8_t)P.out[i], (uint8_t)P.color[i], (uint8_t)P.type[i]};
+  h.frame=(uint64_t)frame; h.drawn=(uint64_t)drawn;
+
+  h.seq.store(s+2, memory_order_release);
+}
+
+void Publisher::close(){
+  if (base){ munmap(base, size); base=nullptr; size=0; }
+  if (fd>=0){ ::close(fd); fd=-1; shm_unlink(name.c_str()); }
+}
+
+bool ShmReader::open(const char* shmName, string& err){
+  fd=shm_open(shm_path(shmName).c_str(), O_RDONLY, 0);
+  if (fd<0){ err=strerror(errno); return false; }
+  struct stat st{};
+  if (fstat(fd, &st)!=0 || (size_t)st.st_size<sizeof(ShmHeader)){ err="not a pipes segment"; close(); return false; }
+  void* m=mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (m==MAP_FAILED){ err=strerror(errno); close(); return false; }
+  base=(const unsigned char*)m; size=(size_t)st.st_size;
+  const ShmHeader& h=hdr();
+  if (memcmp(h.magic, "PIPESHM", 8)!=0){ err="not a pipes segment"; close(); return false; }
+  if (h.version!=SHM_VERSION || h.headerSize!=sizeof(ShmHeader)){ err="unsupported segment version"; close(); return false; }
+  return true;
+}
+
+void ShmReader::close(){
+  if (base){ munmap((void*)base, size); base=nullptr; size=0; }
+  if (fd>=0){ ::close(fd); fd=-1; }
+}
+
+bool ShmReader::view(ShmView& v){
+  if (hdr().mapSize.load(memory_order_acquire) > size){
+    struct stat st{};
+    if (fstat(fd, &st)!=0) return false;
+    void* m=mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m==MAP_FAILED) return false;
+    munmap((void*)base, size);
+    base=(const unsigned char*)m; size=(size_t)st.st_size;
+  }
+  const ShmHeader& h=hdr();
+  v.W=h.W; v.H=h.H; v.nPipes=h.nPipes; v.frame=h.frame; v.drawn=h.drawn;
+  // A torn read can hold anything; never index past the mapping.
+  if (h.cellsOff + (uint64_t)v.W*v.H*sizeof(ShmCell) > size || h.pipesOff + (uint64_t)v.nPipes*sizeof(ShmPipe) > h.cellsOff) return false;
+  v.cells=(const ShmCell*)(base+h.cellsOff);
+  v.pipes=(const ShmPipe*)(base+h.pipesOff);
+  return true;
+}
+
+bool ShmReader::snapshot(ShmSnapshot& s, int tries){
+  return read([&](const ShmView& v){
+    s.W=(int)v.W; s.H=(int)v.H; s.frame=v.frame; s.drawn=v.drawn;
+    s.cells.assign(v.cells, v.cells+(size_t)v.W*v.H);
+    s.pipes.assign(v.pipes, v.pipes+v.nPipes);
+  }, tries);
+}
+
+#endif
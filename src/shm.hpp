@@ -0,0 +1,104 @@
+// shm.hpp — live canvas published in POSIX shared memory under a seqlock
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Frame;
+struct Pipes;
+
+// Segment layout (version SHM_VERSION): ShmHeader, then the glyph table, the pipe
+// states and the W*H cell grid, each at the offset the header gives. Cells come last
+// so a larger canvas only extends the segment; mapSize says how far.
+// Readers never block the writer: they copy under the seqlock and retry on a change.
+constexpr uint32_t SHM_VERSION = 1;
+
+struct ShmCell  { uint16_t glyph; uint8_t color, attr; };        // glyph id (0 = blank), SGR fg code, bit 0 = bold
+struct ShmPipe  { int32_t x, y; uint8_t in, out, color, type; }; // directions UP/DOWN/LEFT/RIGHT = 0..3; palette and type indices
+struct ShmGlyph { char b[4]; uint8_t n; };                       // UTF-8 bytes of a glyph id
+
+struct ShmHeader {
+  char magic[8];                     // "PIPESHM"
+  uint32_t version, headerSize;
+  uint32_t writerPid, nGlyphs;
+  std::atomic<uint64_t> mapSize;     // whole segment; remap when it exceeds your mapping
+  std::atomic<uint64_t> seq;         // odd while the writer is inside
+  // Guarded by seq:
+  uint32_t W, H, nPipes, pad;
+  uint64_t frame, drawn;
+  uint64_t glyphsOff, pipesOff, cellsOff;
+};
+
+#ifndef _WIN32
+
+// Writer side: owns the segment and keeps the cell grid current from each tick's puts.
+struct Publisher {
+  std::string name;
+  int fd=-1;
+  unsigned char* base=nullptr;
+  size_t size=0;
+  std::vector<ShmCell> scratch;      // reshape buffer
+
+  bool open(const char* shmName, int W, int H, size_t pipes, std::string& err);
+  // Puts from index 'from' on; 'cleared' blanks the grid first. Size changes follow f.W/f.H.
+  void publish(const Frame& f, size_t from, bool cleared, const Pipes& P, long long frame, long long drawn);
+  void close();
+  ~Publisher(){ close(); }
+private:
+  ShmHeader& hdr() const { return *(ShmHeader*)base; }
+  bool map(size_t bytes);
+};
+
+struct ShmSnapshot {
+  int W=0, H=0;
+  uint64_t frame=0, drawn=0;
+  std::vector<ShmCell> cells;
+  std::vector<ShmPipe> pipes;
+};
+
+struct ShmView {
+  uint32_t W=0, H=0, nPipes=0;
+  uint64_t frame=0, drawn=0;
+  const ShmCell* cells=nullptr;
+  const ShmPipe* pipes=nullptr;
+};
+
+// Reader side: maps the segment read-only; no syscalls per read unless it grew.
+struct ShmReader {
+  int fd=-1;
+  const unsigned char* base=nullptr;
+  size_t size=0;
+  long long retries=0;               // reads that raced the writer
+
+  bool open(const char* shmName, std::string& err);
+  void close();
+  ~ShmReader(){ close(); }
+  const ShmHeader& hdr() const { return *(const ShmHeader*)base; }
+  const ShmGlyph* glyphs() const { return (const ShmGlyph*)(base + hdr().glyphsOff); }
+  // Zero-copy: f(view) runs against the live segment and is retried until the writer
+  // did not touch it meanwhile; only what f kept from the last run is valid.
+  template <class F> bool read(F&& f, int tries=1000){
+    for (int t=0;t<tries;t++){
+      const uint64_t s=hdr().seq.load(std::memory_order_acquire);
+      ShmView v;
+      if (!(s & 1) && view(v)){
+        f(v);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (hdr().seq.load(std::memory_order_relaxed)==s) return true;
+      }
+      ++retries;
+    }
+    return false;
+  }
+  // Consistent copy of the grid and the pipes.
+  bool snapshot(ShmSnapshot& s, int tries=1000);
+private:
+  // Header fields read once and checked against the mapping (remapped if the segment grew).
+  bool view(ShmView& v);
+};
+
+#endif
@@ -0,0 +1,331 @@
+// term.cpp — terminal output layer (Windows/Linux)
+
+#include "term.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+
+#ifndef _WIN32
+  #include <sys/ioctl.h>
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <signal.h>
+  #include <poll.h>
+#endif
+
+using namespace std;
+
+Term term;
+
+#ifndef _WIN32
+static volatile sig_atomic_t g_resized=0;
+static void on_resize(int){ g_resized=true; }
+
+bool write_all(int fd, const char* p, size_t n, long long* calls){
+  while (n){
+    ssize_t w=::write(fd,p,n);
+    ++*calls;
+    if (w>0){ p+=w; n-=(size_t)w; continue; }
+    if (w<0 && errno==EINTR) continue;
+    if (w<0 && (errno==EAGAIN || errno==EWOULDBLOCK)){
+      pollfd pfd{fd,POLLOUT,0};
+      poll(&pfd,1,-1);
+      continue;
+    }
+    return false;
+  }
+  return true;
+}
+#else
+bool write_all(HANDLE h, const char* p, size_t n, long long* calls){
+  while (n){
+    DWORD w=0;
+    ++*calls;
+    if (!WriteFile(h,p,(DWORD)min<size_t>(n,1u<<30),&w,nullptr)) return false;
+    p+=w; n-=w;
+  }
+  return true;
+}
+#endif
+
+void Out::commit(){
+  if (!len) return;
+  bytes+=(long long)len;
+#ifndef _WIN32
+  if (async && sink==SINK_TTY){
+    size_t off=0;
+    if (!backlog()){
+      pend.clear(); pendOff=0;
+      while (off<len){
+        const ssize_t w=::write(STDOUT_FILENO, buf.data()+off, len-off);
+        ++writes;
+        if (w>0) off+=(size_t)w;
+        else if (w<0 && errno==EINTR) continue;
+        else break;
+      }
+    }
+    // Keep the whole frame so abandon() can see the sequence a partial write stopped in.
+    if (off<len){
+      if (pendOff > pend.size()/2){ pend.erase(pend.begin(), pend.begin()+(long)pendOff); pendOff=0; }
+      if (!backlog()) pendOff=pend.size()+off;
+      pend.insert(pend.end(), buf.data(), buf.data()+len);
+      peak=max(peak, backlog());
+    }
+    len=0;
+    return;
+  }
+#endif
+  switch (sink){
+    case SINK_NULL: ++writes; break;
+    case SINK_MEM:
+      if (mem.size()+len > memCap) mem.clear();
+      mem.insert(mem.end(), buf.data(), buf.data()+len); ++writes;
+      break;
+#ifdef _WIN32
+    default: write_all(GetStdHandle(STD_OUTPUT_HANDLE), buf.data(), len, &writes); break;
+#else
+    case SINK_FD: write_all(fd, buf.data(), len, &writes); break;
+    default: write_all(STDOUT_FILENO, buf.data(), len, &writes); break;
+#endif
+  }
+  len=0;
+}
+
+void Out::setAsync(bool on){
+#ifndef _WIN32
+  if (sink!=SINK_TTY) return;
+  const int flags=fcntl(STDOUT_FILENO, F_GETFL, 0);
+  fcntl(STDOUT_FILENO, F_SETFL, on ? flags|O_NONBLOCK : flags&~O_NONBLOCK);
+  async=on;
+#else
+  (void)on;
+#endif
+}
+
+bool Out::drain(int timeoutMs, int wakeFd){
+#ifndef _WIN32
+  if (!backlog()) return true;
+  const auto t0=chrono::steady_clock::now();
+  size_t sent=0;
+  while (backlog()){
+    int left=-1;
+    if (timeoutMs>=0){
+      left=timeoutMs-(int)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now()-t0).count();
+      if (left<=0) break;
+    }
+    pollfd pfd[2]={{STDOUT_FILENO,POLLOUT,0}, {wakeFd,POLLIN,0}};
+    const int r=poll(pfd, wakeFd>=0 ? 2 : 1, left);
+    if (r<0 && errno==EINTR) continue;
+    if (r<=0 || (wakeFd>=0 && pfd[1].revents)) break;
+    if (!pfd[0].revents) continue;
+    const ssize_t w=::write(STDOUT_FILENO, pend.data()+pendOff, backlog());
+    ++writes;
+    if (w>0){ pendOff+=(size_t)w; sent+=(size_t)w; }
+    else if (w<0 && errno!=EINTR && errno!=EAGAIN){ pendOff=pend.size(); break; }   // terminal gone
+  }
+  const double dt=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+  if (sent && dt>1e-3){
+    const double r=(double)sent/dt;
+    drainRate = drainRate>0 ? 0.8*drainRate+0.2*r : r;
+  }
+  if (!backlog()){ pend.clear(); pendOff=0; }
+#else
+  (void)timeoutMs; (void)wakeFd;
+#endif
+  return !backlog();
+}
+
+void Out::abandon(){
+#ifndef _WIN32
+  // Also discard what the tty layer still holds. The cut may land inside a CSI or
+  // a UTF-8 glyph; the ESC that starts the restore sequence cancels the former and
+  // the closing clear erases the latter.
+  if (isatty(STDOUT_FILENO)) tcflush(STDOUT_FILENO, TCOFLUSH);
+#endif
+  pend.clear(); pendOff=0;
+}
+
+#ifdef _WIN32
+void Term::enableVT(){
+  SetConsoleOutputCP(CP_UTF8);
+  SetConsoleCP(CP_UTF8);
+  DWORD m=0; hout=GetStdHandle(STD_OUTPUT_HANDLE);
+  if (GetConsoleMode(hout,&m)){ m|=ENABLE_VIRTUAL_TERMINAL_PROCESSING; SetConsoleMode(hout,m); }
+  hin = GetStdHandle(STD_INPUT_HANDLE);
+}
+#endif
+
+void Term::init(){
+#ifdef _WIN32
+  enableVT();
+#else
+  signal(SIGWINCH, on_resize);
+  tcgetattr(STDIN_FILENO,&oldt);
+  termios raw=oldt; raw.c_lflag &= ~(ICANON|ECHO);
+  tcsetattr(STDIN_FILENO,TCSANOW,&raw);
+  termios ot{};
+  if (tcgetattr(STDOUT_FILENO,&ot)==0) lfcr = (ot.c_oflag & OPOST) && (ot.c_oflag & ONLCR);
+  int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
+  fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
+#endif
+  updateSize();
+  hideCursor();
+}
+
+void Term::restore(){
+  resetAttrs();
+  showCursor();
+#ifndef _WIN32
+  tcsetattr(STDIN_FILENO,TCSANOW,&oldt);
+  int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
+  fcntl(STDIN_FILENO, F_SETFL, flags & ~O_NONBLOCK);
+#endif
+  out.commit();
+}
+
+// After the probe timeout, how long late replies are still drained before stdin is flushed.
+static constexpr auto PROBE_GRACE = chrono::milliseconds(1000);
+
+void Term::probe(int timeoutMs){
+#ifndef _WIN32
+  if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO)) return;
+  out.put("\r \033[2b\033[6n\033[?2026$p\033[c\r\033[K");
+  out.commit();
+  char in[512]; size_t n=0;
+  auto deadline=chrono::steady_clock::now()+chrono::milliseconds(timeoutMs);
+  bool done=false, late=false;
+  while (!done && n<sizeof in){
+    const auto left=chrono::duration_cast<chrono::milliseconds>(deadline-chrono::steady_clock::now()).count();
+    pollfd pfd{STDIN_FILENO,POLLIN,0};
+    if (left<=0 || poll(&pfd,1,(int)left)<=0){
+      // Past the timeout, replies still on the way would reach the event loop as keys
+      // (ESC quits): keep swallowing them, without using them, until the DA1 sentinel.
+      if (late) break;
+      late=true; deadline=chrono::steady_clock::now()+PROBE_GRACE;
+      continue;
+    }
+    const ssize_t r=::read(STDIN_FILENO, in+n, sizeof in-n);
+    if (r<=0) continue;
+    n+=(size_t)r;
+    // Parse CSI replies: ESC [ [?] params [$] final
+    for (size_t i=0; i+2<n; i++){
+      if (in[i]!='\033' || in[i+1]!='[') continue;
+      size_t k=i+2; bool priv=false, dollar=false;
+      if (in[k]=='?'){ priv=true; ++k; }
+      int p[8]={}, np=0;
+      for (; k<n && ((in[k]>='0' && in[k]<='9') || in[k]==';'); k++){
+        if (in[k]==';'){ if (np<7) ++np; }
+        else p[np]=p[np]*10+(in[k]-'0');
+      }
+      ++np;
+      if (k<n && in[k]=='$'){ dollar=true; ++k; }
+      if (k>=n) break;
+      const char f=in[k];
+      if (late){ if (priv && f=='c') done=true; }
+      else if (!priv && f=='R' && np==2) caps.rep = p[1]==4;                     // DSR: " " + REP 2 ends on column 4
+      else if (priv && dollar && f=='y' && p[0]==2026) caps.sync = p[1]==1 || p[1]==2;
+      else if (priv && f=='c'){ caps.ech = p[0]>=62; done=true; }            // DA1: VT220 or later has ECH
+      i=k;
+    }
+  }
+  // No sentinel (or no room left): whatever did arrive must not be read as input.
+  if (!done) tcflush(STDIN_FILENO, TCIFLUSH);
+#else
+  (void)timeoutMs;
+#endif
+}
+
+void Term::updateSize(){
+#ifdef _WIN32
+  CONSOLE_SCREEN_BUFFER_INFO csbi;
+  GetConsoleScreenBufferInfo(hout,&csbi);
+  W = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+  H = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+#else
+  winsize w{}; ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+  W = w.ws_col; H = w.ws_row;
+#endif
+}
+
+void Term::canvas(int w, int h){
+  cx=cy=-1;
+  // Worst case per cell: CUP + SGR + 4-byte glyph.
+  out.reserve((size_t)max(w,1)*max(h,1)*32 + 4096);
+}
+
+bool Term::checkResize(){
+#ifdef _WIN32
+  int ow=W, oh=H; updateSize();
+  return ow!=W || oh!=H;
+#else
+  if (g_resized){ g_resized=0; updateSize(); return true; }
+  return false;
+#endif
+}
+
+void Term::markResized(){
+#ifndef _WIN32
+  g_resized=1;
+#endif
+}
+
+bool Term::resizePending(){
+#ifdef _WIN32
+  CONSOLE_SCREEN_BUFFER_INFO csbi;
+  if (!GetConsoleScreenBufferInfo(hout,&csbi)) return false;
+  return csbi.srWindow.Right-csbi.srWindow.Left+1!=W || csbi.srWindow.Bottom-csbi.srWindow.Top+1!=H;
+#else
+  return g_resized!=0;
+#endif
+}
+
+void Term::clear(){ out.put("\033[2J\033[H"); out.commit(); cx=cy=0; }
+
+int Term::plan(int x, int y, char* buf) const {
+  if (cx==x && cy==y) return 0;
+  int n=0; buf[n++]='\033'; buf[n++]='[';
+  if (x!=0 || y!=0){ n+=put_uint(buf+n,(unsigned)(y+1)); buf[n++]=';'; n+=put_uint(buf+n,(unsigned)(x+1)); }
+  buf[n++]='H';
+  if (cx<0 || cy<0) return n;
+
+  char v[3][24]; int vl[3], vc[3], nv=0;      // vertical candidates and resulting column
+  const int dy=y-cy;
+  if (dy==0){ vl[nv]=0; vc[nv++]=cx; }
+  else {
+    vl[nv]=put_csi(v[nv], dy<0? -dy: dy, dy<0? 'A':'B'); vc[nv++]=cx;
+    vl[nv]=put_csi(v[nv], y+1, 'd'); vc[nv++]=cx;
+    if (dy>0 && dy<=(int)sizeof v[0]){ memset(v[nv],'\n',dy); vl[nv]=dy; vc[nv++]= lfcr? 0: cx; }
+  }
+  for (int i=0;i<nv;i++){
+    char h[24]; int hl=-1; const int c=vc[i];
+    if (c==x) hl=0;
+    else {
+      char t[24]; int tl;
+      hl=put_csi(h, x+1, 'G');
+      tl=put_csi(t, x>c? x-c: c-x, x>c? 'C':'D'); if (tl<hl){ memcpy(h,t,tl); hl=tl; }
+      if (x==0){ h[0]='\r'; hl=1; }
+      else if (1+(tl=put_csi(t+1, x, 'C')) < hl){ t[0]='\r'; memcpy(h,t,tl+1); hl=tl+1; }
+    }
+    if (vl[i]+hl < n){ memcpy(buf,v[i],vl[i]); memcpy(buf+vl[i],h,hl); n=vl[i]+hl; }
+  }
+  return n;
+}
+
+void Term::sgr(int fg, bool bold){
+  if (fg==sfg && (int)bold==sbold) return;
+  char* buf=out.room(24); int n=0; buf[n++]='\033'; buf[n++]='[';
+  if (sfg<0 || sbold<0){
+    buf[n++]='0';
+    if (bold){ buf[n++]=';'; buf[n++]='1'; }
+    if (fg!=39){ buf[n++]=';'; n+=put_uint(buf+n,(unsigned)fg); }
+  } else {
+    if ((int)bold!=sbold){ if (bold) buf[n++]='1'; else { buf[n++]='2'; buf[n++]='2'; } }
+    if (fg!=sfg){ if (buf[n-1]!='[') buf[n++]=';'; n+=put_uint(buf+n,(unsigned)fg); }
+  }
+  buf[n++]='m';
+  out.len+=n;
+  sfg=fg; sbold=bold;
+}
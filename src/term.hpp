@@ -0,0 +1,127 @@
+// term.hpp — terminal output layer: frame arena, sinks, cursor planner, SGR state
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <termios.h>
+#endif
+
+// CSI helpers: write ESC[<n><f> (n omitted when 1) and return its length
+inline int put_uint(char* p, unsigned v){
+  char t[10]; int n=0;
+  do { t[n++]=(char)('0'+v%10); v/=10; } while (v);
+  for (int i=0;i<n;i++) p[i]=t[n-1-i];
+  return n;
+}
+inline int put_csi(char* p, int n, char f){
+  int k=0; p[k++]='\033'; p[k++]='[';
+  if (n!=1) k+=put_uint(p+k,(unsigned)n);
+  p[k++]=f; return k;
+}
+
+// Push a whole buffer to an fd, riding out partial writes, EINTR and EAGAIN.
+// Returns false on a hard error; *calls counts the write syscalls issued.
+#ifndef _WIN32
+bool write_all(int fd, const char* p, size_t n, long long* calls);
+#else
+bool write_all(HANDLE h, const char* p, size_t n, long long* calls);
+#endif
+
+// Output sinks: the terminal, or headless targets for benchmarking.
+enum Sink { SINK_TTY, SINK_NULL, SINK_MEM, SINK_FD };
+
+// Frame output arena: fixed capacity sized from the screen, reused across frames,
+// committed with a single write. Overflow commits early rather than growing.
+struct Out {
+  std::vector<char> buf;
+  size_t len=0;
+  Sink sink=SINK_TTY;
+  int fd=-1;                   // SINK_FD target
+  std::vector<char> mem;       // SINK_MEM capture, recycled past memCap
+  size_t memCap=64u<<20;
+  long long bytes=0, writes=0; // totals committed / write calls issued
+  // Async TTY mode (render thread): commit() never blocks. What the terminal has
+  // not taken yet waits in pend and goes out from drain(); the caller keeps the
+  // backlog bounded by not encoding while it is above lowWater().
+  bool async=false;
+  std::vector<char> pend;
+  size_t pendOff=0, peak=0;
+  double drainRate=0;          // bytes/s the terminal accepted while backlogged (EWMA)
+  void reserve(size_t cap){ if (buf.size()<cap) buf.resize(cap); }
+  char* room(size_t n){ if (len+n>buf.size()){ commit(); reserve(n); } return buf.data()+len; }
+  void put(char c){ *room(1)=c; ++len; }
+  void put(const char* p, size_t n){ memcpy(room(n),p,n); len+=n; }
+  void put(const char* p){ put(p,strlen(p)); }
+  void put(const std::string& s){ put(s.data(),s.size()); }
+  void commit();
+  void setAsync(bool on);
+  size_t backlog() const { return pend.size()-pendOff; }
+  // About 10 ms of output at the measured drain rate.
+  size_t lowWater() const { return std::max<size_t>(4096, (size_t)(drainRate/100)); }
+  // Write queued bytes for up to timeoutMs (<0: no limit); true once the queue is empty.
+  // Also returns as soon as wakeFd, when given, turns readable (POSIX).
+  bool drain(int timeoutMs, int wakeFd=-1);
+  // Quit path: drop the queue and whatever the tty has not sent yet.
+  void abandon();
+};
+
+struct Term {
+  int W=80, H=24;
+  Out out;
+  int cx=-1, cy=-1;        // tracked cursor position, -1 = unknown
+  int sfg=-1, sbold=-1;    // tracked SGR state, -1 = unknown
+  bool lfcr=true;          // output LF also returns the carriage (ONLCR)
+  // Optional encodings, from probe() or --caps.
+  struct Caps {
+    bool sync=false;       // DEC mode 2026: synchronized update around each frame
+    bool rep=false;        // REP: repeat the last graphic character
+    bool ech=false;        // ECH: erase characters without moving
+  } caps;
+  size_t syncMark=0;
+#ifdef _WIN32
+  HANDLE hout{}, hin{};
+  void enableVT();
+#else
+  termios oldt{};
+#endif
+  void init();
+  void restore();
+  void updateSize();
+  // Ask the terminal what it supports (DECRQM 2026, a REP test read back with DSR, DA1 level for ECH).
+  // DA1 goes last as the sentinel every terminal answers; gives up after timeoutMs, then
+  // drains replies that are still coming so none is left for the input loop.
+  void probe(int timeoutMs);
+  // Bracket one frame in BSU/ESU when sync is on; an empty frame leaves no bytes behind.
+  void syncBegin(){ syncMark=out.len; if (caps.sync) out.put("\033[?2026h"); }
+  void syncEnd(){ if (caps.sync){ if (out.len==syncMark+8) out.len=syncMark; else out.put("\033[?2026l"); } }
+  // Output side of a canvas (re)size: cursor is unknown, arena sized for a full repaint.
+  void canvas(int w, int h);
+  bool checkResize();
+  // Resize bookkeeping for the event loop: a SIGWINCH seen elsewhere (signalfd), or a pending one.
+  void markResized();
+  bool resizePending();
+  void clear();
+  // Cursor motion planner (mvcur-like): cheapest of CUP, CUU/CUD/VPA/LF + CUF/CUB/HPA/CR.
+  int plan(int x, int y, char* buf) const;
+  void mv(int x,int y){
+    out.len += plan(x,y,out.room(64));
+    cx=x; cy=y;
+  }
+  // SGR state machine: emit only the parameters that differ from what the terminal has.
+  void sgr(int fg, bool bold);
+  void resetAttrs(){ if (sfg!=39 || sbold!=0){ out.put("\033[0m"); sfg=39; sbold=0; } }
+  // Cursor moved right by n printed cells; the last column leaves a pending wrap.
+  void advance(int w, int n=1){ if (cx>=0 && (cx+=n)>=w) cx=cy=-1; }
+  void hideCursor(){ out.put("\033[?25l"); }
+  void showCursor(){ out.put("\033[?25h"); }
+};
+extern Term term;
@@ -0,0 +1,62 @@
+// peek.cpp — example reader for a canvas published with pipes --publish NAME
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "shm.hpp"
+
+using namespace std;
+
+int main(int argc, char** argv){
+#ifdef _WIN32
+  (void)argc; (void)argv;
+  fprintf(stderr, "pipes_peek: shared memory publishing is POSIX only\n");
+  return 1;
+#else
+  if (argc<2 || argv[1][0]=='-'){
+    fprintf(stderr, "Usage: %s NAME [--rate SECS]\n"
+                    "Prints the live canvas once, or measures snapshot reads for SECS seconds.\n", argv[0]);
+    return 1;
+  }
+  double rate = argc>3 && string(argv[2])=="--rate" ? atof(argv[3]) : 0;
+
+  ShmReader r;
+  string err;
+  if (!r.open(argv[1], err)){ fprintf(stderr, "pipes_peek: %s: %s\n", argv[1], err.c_str()); return 1; }
+  ShmSnapshot s;
+
+  // Read rate: back-to-back snapshots; the writer never waits on us.
+  if (rate>0){
+    using clk=chrono::steady_clock;
+    long long reads=0, failed=0;
+    uint64_t first=0, last=0;
+    const auto until=clk::now()+chrono::duration<double>(rate);
+    while (clk::now()<until){
+      if (!r.snapshot(s)){ ++failed; continue; }
+      if (!reads++) first=s.frame;
+      last=s.frame;
+    }
+    printf("%lld snapshots in %.1f s (%.0f/s), %lld retries, %lld failed, frames %llu..%llu\n",
+           reads, rate, reads/rate, r.retries, failed, (unsigned long long)first, (unsigned long long)last);
+    return 0;
+  }
+
+  if (!r.snapshot(s)){ fprintf(stderr, "pipes_peek: no consistent snapshot\n"); return 1; }
+  printf("frame %llu  %dx%d  pipes %zu  drawn %llu  writer pid %u\n",
+         (unsigned long long)s.frame, s.W, s.H, s.pipes.size(), (unsigned long long)s.drawn, r.hdr().writerPid);
+  const ShmGlyph* g=r.glyphs();
+  string line;
+  for (int y=0;y<s.H;y++){
+    line.clear();
+    for (int x=0;x<s.W;x++){
+      const ShmCell& c=s.cells[(size_t)y*s.W+x];
+      if (c.glyph < r.hdr().nGlyphs) line.append(g[c.glyph].b, g[c.glyph].n); else line+='?';
+    }
+    while (!line.empty() && line.back()==' ') line.pop_back();
+    puts(line.c_str());
+  }
+  return 0;
+#endif
+}